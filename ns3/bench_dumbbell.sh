@@ -0,0 +1,16 @@
+#!/bin/bash
+
+# Setup time and memory of the dumbbell topology against that of
+# chapter5-base, at 1k and 10k flows (see scratch/dumbbell-bench.cc).
+
+out=data/dumbbell-bench.txt
+echo "# topology flows setup[s] run[s] events maxrss-after-setup[KiB] maxrss[KiB]" > $out
+
+./waf build || exit 1
+for nf in 1000 10000; do
+for topology in dumbbell legacy; do
+  echo "----- Benchmarking $topology $nf -----"
+  ./waf --run-no-build "dumbbell-bench --topology=$topology --num_flows=$nf" | tail -n 1 >> $out
+done
+done
+cat $out
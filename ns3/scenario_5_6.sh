@@ -1,19 +1,27 @@
 #!/bin/bash
 
 sc=6
-rm data/05_xx-sc${sc}-*
 
 ALGORITHMS=(TcpCubic)
+BANDWIDTHS=(10Mbps 50Mbps)
+DELAYS=(10ms 100ms)
 
 a_bw=1Gbps
 a_dl=10ms
 time=100
 
+# 全ての組み合わせを並列に実行し，終わってからグラフを描く．
+python3 sweep.py --out data/runs --name 05_xx-sc${sc} \
+  --axis transport_prot=$(IFS=,; echo "${ALGORITHMS[*]}") \
+  --axis bandwidth=$(IFS=,; echo "${BANDWIDTHS[*]}") \
+  --axis delay=$(IFS=,; echo "${DELAYS[*]}") \
+  chapter5-base --tracing=True --duration=$time --access_bandwidth=$a_bw --access_delay=$a_dl || exit 1
+
 for item in ${ALGORITHMS[@]}; do
-for bw in 10Mbps 50Mbps; do
-for dl in 10ms 100ms; do
-  echo "----- Simulating $item $bw $dl -----"
-  ./waf --run "chapter5-base --transport_prot=$item --prefix_name='data/05_xx-sc${sc}-$item-${bw}-${dl}' --tracing=True --duration=$time --bandwidth=$bw --delay=$dl --access_bandwidth=$a_bw --access_delay=$a_dl"
+for bw in ${BANDWIDTHS[@]}; do
+for dl in ${DELAYS[@]}; do
+  echo "----- Plotting $item $bw $dl -----"
+  p=data/runs/05_xx-sc${sc}-$item-${bw}-${dl}/05_xx-sc${sc}-$item-${bw}-${dl}
 
   # gnuplot
   case "$bw" in
@@ -27,7 +35,7 @@ for dl in 10ms 100ms; do
   for flw in 0; do
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 1.25
-	set output 'data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-cwnd.png'
+	set output '${p}-flw${flw}-cwnd.png'
 	set xlabel "Time [s]"
 	set ylabel "Window size [byte]"
 	set y2label "Throughput [Mbps]"
@@ -36,37 +44,37 @@ for dl in 10ms 100ms; do
 	set y2range [0:$rng]
 	set y2tics $tcs
 	f(x)=65535
-	plot "data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-cwnd.data" using 1:2 axis x1y1 title "Cwnd" with lines lc rgb "grey" lw 2 dt (10,0), f(x) axis x1y1 title "Rwnd" with lines lc rgb "dark-grey" lw 2 dt (5,5), "data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-throughput.data" using 1:2 axis x1y2 title "Throughput" with lines lc rgb "black" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-cwnd.data" using 1:2 axis x1y1 title "Cwnd" with lines lc rgb "grey" lw 2 dt (10,0), f(x) axis x1y1 title "Rwnd" with lines lc rgb "dark-grey" lw 2 dt (5,5), "${p}-flw${flw}-throughput.data" using 1:2 axis x1y2 title "Throughput" with lines lc rgb "black" lw 2 dt (10,0)
 	EOS
 
   # RTT
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 1.25
-	set output 'data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-rtt.png'
+	set output '${p}-flw${flw}-rtt.png'
 	set xlabel "Time [s]"
 	set ylabel "RTT [s]"
 	set xrange [0:$time]
-	plot "data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-rtt.data" using 1:2 notitle with lines lc rgb "grey" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-rtt.data" using 1:2 notitle with lines lc rgb "grey" lw 2 dt (10,0)
 	EOS
 
   # cong-state
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 1.25
-	set output 'data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-cong-state.png'
+	set output '${p}-flw${flw}-cong-state.png'
 	set xlabel "Time [s]"
 	set ylabel "State"
 	set xrange [0:$time]
 	set yrange [0:4.5]
 	set ytics 1
-	plot "data/05_xx-sc${sc}-$item-${bw}-${dl}-flw${flw}-cong-state.data" using 1:2 notitle with steps lc rgb "grey" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-cong-state.data" using 1:2 notitle with steps lc rgb "grey" lw 2 dt (10,0)
 	EOS
   done
 
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*cwnd.data data/chapter5/sc${sc}/.
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*rtt.data data/chapter5/sc${sc}/.
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*cong-state.data data/chapter5/sc${sc}/.
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*throughput.data data/chapter5/sc${sc}/.
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*.png data/chapter5/sc${sc}/.
+  mv ${p}-*cwnd.data data/chapter5/sc${sc}/.
+  mv ${p}-*rtt.data data/chapter5/sc${sc}/.
+  mv ${p}-*cong-state.data data/chapter5/sc${sc}/.
+  mv ${p}-*throughput.data data/chapter5/sc${sc}/.
+  mv ${p}-*.png data/chapter5/sc${sc}/.
 done
 done
 done
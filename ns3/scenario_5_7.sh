@@ -1,34 +1,42 @@
 #!/bin/bash
 
 sc=7
-rm data/05_xx-sc${sc}-*
 
 ALGORITHMS=(TcpCubic)
+BANDWIDTHS=(50Mbps)
+DELAYS=(10ms)
 
 a_bw=1Gbps
 a_dl=10ms
 time=100
 
+# 全ての組み合わせを並列に実行し，終わってからグラフを描く．
+python3 sweep.py --out data/runs --name 05_xx-sc${sc} \
+  --axis transport_prot2=$(IFS=,; echo "${ALGORITHMS[*]}") \
+  --axis bandwidth=$(IFS=,; echo "${BANDWIDTHS[*]}") \
+  --axis delay=$(IFS=,; echo "${DELAYS[*]}") \
+  chapter5-diffTcp --transport_prot=TcpNewReno --tracing=True --duration=$time --access_bandwidth=$a_bw --access_delay=$a_dl || exit 1
+
 for item in ${ALGORITHMS[@]}; do
-for bw in 50Mbps; do
-for dl in 10ms; do
-  echo "----- Simulating $item $bw $dl -----"
-  ./waf --run "chapter5-diffTcp --transport_prot=TcpNewReno --transport_prot2=$item --prefix_name='data/05_xx-sc${sc}-$item-${bw}-${dl}' --tracing=True --duration=$time --bandwidth=$bw --delay=$dl --access_bandwidth=$a_bw --access_delay=$a_dl"
-#  ./waf --run chapter5-diffTcp --command-template="gdb --args %s --transport_prot=TcpNewReno --transport_prot2=$item --prefix_name='data/05_xx-sc${sc}-$item-${bw}-${dl}' --tracing=True --duration=$time --bandwidth=$bw --delay=$dl --access_bandwidth=$a_bw --access_delay=$a_dl"
+for bw in ${BANDWIDTHS[@]}; do
+for dl in ${DELAYS[@]}; do
+  echo "----- Plotting $item $bw $dl -----"
+  p=data/runs/05_xx-sc${sc}-$item-${bw}-${dl}/05_xx-sc${sc}-$item-${bw}-${dl}
+#  ./waf --run chapter5-diffTcp --command-template="gdb --args %s --transport_prot=TcpNewReno --transport_prot2=$item --prefix_name='${p}' --tracing=True --duration=$time --bandwidth=$bw --delay=$dl --access_bandwidth=$a_bw --access_delay=$a_dl"
 
   # gnuplot
   # throughput-comparison
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 2.5 size 1280,960
-	set output 'data/05_xx-sc${sc}-$item-${bw}-${dl}-throughput-comp.png'
+	set output '${p}-throughput-comp.png'
 	set xlabel "Time [s]"
 	set ylabel "Throughput [Mbps]"
 	set xrange [0:$time]
-	plot "data/05_xx-sc${sc}-$item-${bw}-${dl}-flw0-throughput.data" using 1:2 title "NewReno" with lines lc rgb "black" lw 2 dt (10,0), "data/05_xx-sc${sc}-$item-${bw}-${dl}-flw1-throughput.data" using 1:2 title "${item}" with lines lc rgb "grey" lw 2 dt (10,0)
+	plot "${p}-flw0-throughput.data" using 1:2 title "NewReno" with lines lc rgb "black" lw 2 dt (10,0), "${p}-flw1-throughput.data" using 1:2 title "${item}" with lines lc rgb "grey" lw 2 dt (10,0)
 	EOS
 
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*throughput.data data/chapter5/sc${sc}/.
-  mv data/05_xx-sc${sc}-$item-${bw}-${dl}-*.png data/chapter5/sc${sc}/.
+  mv ${p}-*throughput.data data/chapter5/sc${sc}/.
+  mv ${p}-*.png data/chapter5/sc${sc}/.
 done
 done
 done
@@ -1,17 +1,23 @@
 #!/bin/bash
 
 sc=15
-rm data/06_xx-sc${sc}-*
 
 ALGORITHMS=(TcpBbr)
+QUEUES=(100 1000 10000)
 
 time=100
 nf=8
 
+# 全ての組み合わせを並列に実行し，終わってからグラフを描く．
+python3 sweep.py --out data/runs --name 06_xx-sc${sc} \
+  --axis transport_prot=$(IFS=,; echo "${ALGORITHMS[*]}") \
+  --axis q_size=$(IFS=,; echo "${QUEUES[*]}") \
+  chapter6-base --tracing=True --duration=$time --num_flows=${nf} || exit 1
+
 for item in ${ALGORITHMS[@]}; do
-for q in 100 1000 10000; do
-  echo "----- Simulating $item ${q} -----"
-  ./waf --run "chapter6-base --transport_prot=$item --prefix_name='data/06_xx-sc${sc}-$item-${q}' --tracing=True --duration=$time --num_flows=${nf} --q_size=${q}"
+for q in ${QUEUES[@]}; do
+  echo "----- Plotting $item ${q} -----"
+  p=data/runs/06_xx-sc${sc}-$item-${q}/06_xx-sc${sc}-$item-${q}
 
   # gnuplot
   # cwnd
@@ -19,7 +25,7 @@ for q in 100 1000 10000; do
   for flw in 0; do
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 2.5 size 1280,960
-	set output 'data/06_xx-sc${sc}-$item-${q}-flw${flw}-cwnd.png'
+	set output '${p}-flw${flw}-cwnd.png'
 	set xlabel "Time [s]"
 	set ylabel "Window size [byte]"
 	set y2label "Throughput [Mbps]"
@@ -28,47 +34,47 @@ for q in 100 1000 10000; do
 	set y2range [0:10]
 	set y2tics 1
 	f(x)=65535
-	plot "data/06_xx-sc${sc}-$item-${q}-flw${flw}-cwnd.data" using 1:2 axis x1y1 title "Cwnd" with lines lc rgb "grey" lw 2 dt (10,0), f(x) axis x1y1 title "Rwnd" with lines lc rgb "dark-grey" lw 2 dt (5,5), "data/06_xx-sc${sc}-$item-${q}-flw${flw}-throughput.data" using 1:2 axis x1y2 title "Throughput" with lines lc rgb "black" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-cwnd.data" using 1:2 axis x1y1 title "Cwnd" with lines lc rgb "grey" lw 2 dt (10,0), f(x) axis x1y1 title "Rwnd" with lines lc rgb "dark-grey" lw 2 dt (5,5), "${p}-flw${flw}-throughput.data" using 1:2 axis x1y2 title "Throughput" with lines lc rgb "black" lw 2 dt (10,0)
 	EOS
 
   # RTT
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 2.5 size 1280,960
-	set output 'data/06_xx-sc${sc}-$item-${q}-flw${flw}-rtt.png'
+	set output '${p}-flw${flw}-rtt.png'
 	set xlabel "Time [s]"
 	set ylabel "RTT [s]"
 	set xrange [0:$time]
-	plot "data/06_xx-sc${sc}-$item-${q}-flw${flw}-rtt.data" using 1:2 notitle with lines lc rgb "grey" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-rtt.data" using 1:2 notitle with lines lc rgb "grey" lw 2 dt (10,0)
 	EOS
 
   # cong-state
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 2.5 size 1280,960
-	set output 'data/06_xx-sc${sc}-$item-${q}-flw${flw}-cong-state.png'
+	set output '${p}-flw${flw}-cong-state.png'
 	set xlabel "Time [s]"
 	set ylabel "State"
 	set xrange [0:$time]
 	set yrange [0:4.5]
 	set ytics 1
-	plot "data/06_xx-sc${sc}-$item-${q}-flw${flw}-cong-state.data" using 1:2 notitle with steps lc rgb "grey" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-cong-state.data" using 1:2 notitle with steps lc rgb "grey" lw 2 dt (10,0)
 	EOS
 
   # InFlight
 	gnuplot <<- EOS
 	set terminal pngcairo enhanced font "TimesNewRoman" fontscale 2.5 size 1280,960
-	set output 'data/06_xx-sc${sc}-$item-${q}-flw${flw}-inflight.png'
+	set output '${p}-flw${flw}-inflight.png'
 	set xlabel "Time [s]"
 	set ylabel "Inflight [byte]"
 	set xrange [0:$time]
-	plot "data/06_xx-sc${sc}-$item-${q}-flw${flw}-inflight.data" using 1:2 notitle with lines lc rgb "grey" lw 2 dt (10,0)
+	plot "${p}-flw${flw}-inflight.data" using 1:2 notitle with lines lc rgb "grey" lw 2 dt (10,0)
 	EOS
   done
 
-  mv data/06_xx-sc${sc}-$item-${q}-*cwnd.data data/chapter6/sc${sc}/.
-  mv data/06_xx-sc${sc}-$item-${q}-*rtt.data data/chapter6/sc${sc}/.
-  mv data/06_xx-sc${sc}-$item-${q}-*inflight.data data/chapter6/sc${sc}/.
-  mv data/06_xx-sc${sc}-$item-${q}-*cong-state.data data/chapter6/sc${sc}/.
-  mv data/06_xx-sc${sc}-$item-${q}-*throughput.data data/chapter6/sc${sc}/.
-  mv data/06_xx-sc${sc}-$item-${q}-*.png data/chapter6/sc${sc}/.
+  mv ${p}-*cwnd.data data/chapter6/sc${sc}/.
+  mv ${p}-*rtt.data data/chapter6/sc${sc}/.
+  mv ${p}-*inflight.data data/chapter6/sc${sc}/.
+  mv ${p}-*cong-state.data data/chapter6/sc${sc}/.
+  mv ${p}-*throughput.data data/chapter6/sc${sc}/.
+  mv ${p}-*.png data/chapter6/sc${sc}/.
 done
 done
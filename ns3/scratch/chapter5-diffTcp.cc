@@ -52,194 +52,15 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/traffic-control-module.h"
 
+#include "flow-stats.h"
+#include "flow-tracer.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("TcpVariantsComparison");
 
-bool firstCwnd = true;
-bool firstSshThr = true;
-bool firstRtt = true;
-bool firstRto = true;
-Ptr<OutputStreamWrapper> cWndStream;
-Ptr<OutputStreamWrapper> ssThreshStream;
-Ptr<OutputStreamWrapper> rttStream;
-Ptr<OutputStreamWrapper> rtoStream;
-Ptr<OutputStreamWrapper> nextTxStream;
-Ptr<OutputStreamWrapper> nextRxStream;
-Ptr<OutputStreamWrapper> inFlightStream;
-Ptr<OutputStreamWrapper> ackStream;
-Ptr<OutputStreamWrapper> congStateStream;
-uint32_t cWndValue;
-uint32_t ssThreshValue;
 double TH_INTERVAL = 5.0;
 
-static void
-CwndTracer (uint32_t oldval, uint32_t newval)
-{
-  if (firstCwnd)
-    {
-      *cWndStream->GetStream () << "0.0 " << oldval << std::endl;
-      firstCwnd = false;
-    }
-  *cWndStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
-  cWndValue = newval;
-
-  if (!firstSshThr)
-    {
-      *ssThreshStream->GetStream () << Simulator::Now ().GetSeconds () << " " << ssThreshValue << std::endl;
-    }
-}
-
-static void
-SsThreshTracer (uint32_t oldval, uint32_t newval)
-{
-  if (firstSshThr)
-    {
-      *ssThreshStream->GetStream () << "0.0 " << oldval << std::endl;
-      firstSshThr = false;
-    }
-  *ssThreshStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
-  ssThreshValue = newval;
-
-  if (!firstCwnd)
-    {
-      *cWndStream->GetStream () << Simulator::Now ().GetSeconds () << " " << cWndValue << std::endl;
-    }
-}
-
-static void
-RttTracer (Time oldval, Time newval)
-{
-  if (firstRtt)
-    {
-      *rttStream->GetStream () << "0.0 " << oldval.GetSeconds () << std::endl;
-      firstRtt = false;
-    }
-  *rttStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval.GetSeconds () << std::endl;
-}
-
-static void
-RtoTracer (Time oldval, Time newval)
-{
-  if (firstRto)
-    {
-      *rtoStream->GetStream () << "0.0 " << oldval.GetSeconds () << std::endl;
-      firstRto = false;
-    }
-  *rtoStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval.GetSeconds () << std::endl;
-}
-
-static void
-NextTxTracer (SequenceNumber32 old, SequenceNumber32 nextTx)
-{
-  *nextTxStream->GetStream () << Simulator::Now ().GetSeconds () << " " << nextTx << std::endl;
-}
-
-static void
-InFlightTracer (uint32_t old, uint32_t inFlight)
-{
-  *inFlightStream->GetStream () << Simulator::Now ().GetSeconds () << " " << inFlight << std::endl;
-}
-
-static void
-NextRxTracer (SequenceNumber32 old, SequenceNumber32 nextRx)
-{
-  *nextRxStream->GetStream () << Simulator::Now ().GetSeconds () << " " << nextRx << std::endl;
-}
-
-static void
-AckTracer (SequenceNumber32 old, SequenceNumber32 newAck)
-{
-  *ackStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newAck << std::endl;
-}
-
-static void
-CongStateTracer (TcpSocketState::TcpCongState_t old, TcpSocketState::TcpCongState_t newState)
-{
-  *congStateStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newState << std::endl;
-}
-
-static void
-TraceCwnd (uint32_t nodeId, std::string cwnd_tr_file_name)
-{
-  AsciiTraceHelper ascii;
-  cWndStream = ascii.CreateFileStream (cwnd_tr_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/CongestionWindow";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&CwndTracer));
-}
-
-static void
-TraceSsThresh (uint32_t nodeId, std::string ssthresh_tr_file_name)
-{
-  AsciiTraceHelper ascii;
-  ssThreshStream = ascii.CreateFileStream (ssthresh_tr_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/SlowStartThreshold";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&SsThreshTracer));
-}
-
-static void
-TraceRtt (uint32_t nodeId, std::string rtt_tr_file_name)
-{
-  AsciiTraceHelper ascii;
-  rttStream = ascii.CreateFileStream (rtt_tr_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/RTT";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&RttTracer));
-}
-
-static void
-TraceRto (uint32_t nodeId, std::string rto_tr_file_name)
-{
-  AsciiTraceHelper ascii;
-  rtoStream = ascii.CreateFileStream (rto_tr_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/RTO";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&RtoTracer));
-}
-
-static void
-TraceNextTx (uint32_t nodeId, std::string &next_tx_seq_file_name)
-{
-  AsciiTraceHelper ascii;
-  nextTxStream = ascii.CreateFileStream (next_tx_seq_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/NextTxSequence";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&NextTxTracer));
-}
-
-static void
-TraceInFlight (uint32_t nodeId, std::string &in_flight_file_name)
-{
-  AsciiTraceHelper ascii;
-  inFlightStream = ascii.CreateFileStream (in_flight_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/BytesInFlight";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&InFlightTracer));
-}
-
-static void
-TraceNextRx (uint32_t nodeId, std::string &next_rx_seq_file_name)
-{
-  AsciiTraceHelper ascii;
-  nextRxStream = ascii.CreateFileStream (next_rx_seq_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/1/RxBuffer/NextRxSequence";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&NextRxTracer));
-}
-
-static void
-TraceAck (uint32_t nodeId, std::string &ack_file_name)
-{
-  AsciiTraceHelper ascii;
-  ackStream = ascii.CreateFileStream (ack_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/HighestRxAck";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&AckTracer));
-}
-
-static void
-TraceCongState (uint32_t nodeId, std::string &cong_state_file_name)
-{
-  AsciiTraceHelper ascii;
-  congStateStream = ascii.CreateFileStream (cong_state_file_name.c_str ());
-  std::string nodelist = "/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/0/CongState";
-  Config::ConnectWithoutContext (nodelist, MakeCallback (&CongStateTracer));
-}
-
 static std::string
 GetTcpAlgorithm (std::string transport_prot)
 {
@@ -336,6 +157,15 @@ int main (int argc, char *argv[])
   std::string access_bandwidth = "10Mbps";
   std::string access_delay = "45ms";
   bool tracing = false;
+  bool binary_trace = false;
+  bool trace_metrics = true;
+  bool trace_columns = false;
+  bool trace_merged = false;
+  std::string trace_mode = "all";
+  double trace_bucket = 0.1;
+  double trace_epsilon = 0.01;
+  bool stats = false;
+  double stats_interval = 1.0;
   std::string prefix_file_name = "TcpVariantsComparison";
   double data_mbytes = 0;
   uint32_t mtu_bytes = 1500;
@@ -360,6 +190,15 @@ int main (int argc, char *argv[])
   cmd.AddValue ("access_bandwidth", "Access link bandwidth", access_bandwidth);
   cmd.AddValue ("access_delay", "Access link delay", access_delay);
   cmd.AddValue ("tracing", "Flag to enable/disable tracing", tracing);
+  cmd.AddValue ("binary_trace", "Write traces in binary (convert with trace2txt.py)", binary_trace);
+  cmd.AddValue ("trace_metrics", "Write one trace file per flow and metric", trace_metrics);
+  cmd.AddValue ("trace_columns", "Write one columnar trace file per flow", trace_columns);
+  cmd.AddValue ("trace_merged", "Write one columnar trace file for all flows", trace_merged);
+  cmd.AddValue ("trace_mode", "Trace samples to write: all, bucket (last/min/max/mean per bucket) or change", trace_mode);
+  cmd.AddValue ("trace_bucket", "Bucket width of trace_mode=bucket in seconds", trace_bucket);
+  cmd.AddValue ("trace_epsilon", "Min relative change written by trace_mode=change", trace_epsilon);
+  cmd.AddValue ("stats", "Write RTT/in-flight/goodput statistics of all flows to a JSON file", stats);
+  cmd.AddValue ("stats_interval", "Goodput interval of stats in seconds", stats_interval);
   cmd.AddValue ("prefix_name", "Prefix of output trace file", prefix_file_name);
   cmd.AddValue ("data", "Number of Megabytes of data to transmit", data_mbytes);
   cmd.AddValue ("mtu", "Size of IP packets to send in bytes", mtu_bytes);
@@ -538,16 +377,25 @@ int main (int argc, char *argv[])
       stack.EnableAsciiIpv4All (ascii_wrap);
       */
 
+      TraceSink::Options trace_options (binary_trace, trace_mode, Seconds (trace_bucket), trace_epsilon);
+      Ptr<TraceSink> merged;
+      if (trace_merged)
+        {
+          merged = FlowTracer::CreateMerged (prefix_file_name + "-flows.data", trace_options);
+        }
+      for (int i = 0; i < num_flows; i++) {
+        Ptr<FlowTracer> tracer = Create<FlowTracer> (i, prefix_file_name + "-flw" + std::to_string(i) + "-", trace_options, trace_metrics, trace_columns, merged);
+        Simulator::Schedule (Seconds (start_time * i + 0.00001), &FlowTracer::ConnectSender, tracer, sources.Get (i)->GetId(), 0);
+        Simulator::Schedule (Seconds (start_time * i + 0.1), &FlowTracer::ConnectReceiver, tracer, sinks.Get (0)->GetId());
+      }
+    }
+
+  Ptr<StatsCollector> collector;
+  if (stats)
+    {
+      collector = Create<StatsCollector> (Seconds (stats_interval));
       for (int i = 0; i < num_flows; i++) {
-        Simulator::Schedule (Seconds (0.00001), &TraceCwnd, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-cwnd.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceSsThresh, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-ssth.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceRtt, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-rtt.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceRto, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-rto.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceNextTx, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-next-tx.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceInFlight, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-inflight.data");
-        Simulator::Schedule (Seconds (0.1), &TraceNextRx, sinks.Get (i)->GetId(),  prefix_file_name + "-flw" + std::to_string(i) + "-next-rx.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceAck, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-ack.data");
-        Simulator::Schedule (Seconds (0.00001), &TraceCongState, sources.Get (i)->GetId(), prefix_file_name + "-flw" + std::to_string(i) + "-cong-state.data");
+        Simulator::Schedule (Seconds (start_time * i + 0.00001), &StatsCollector::AddSender, collector, i, sources.Get (i)->GetId(), 0);
       }
     }
 
@@ -567,6 +415,11 @@ int main (int argc, char *argv[])
   Simulator::Stop (Seconds (stop_time));
   Simulator::Run ();
 
+  if (stats)
+    {
+      collector->Write (prefix_file_name + "-stats.json");
+    }
+
   if (flow_monitor)
     {
       flowHelper.SerializeToXmlFile (prefix_file_name + ".flowmonitor", true, true);
@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Setup time and memory of many-flow topologies.
+//
+// Builds num_flows bulk-send flows either with DumbbellHelper (one shared
+// bottleneck, see dumbbell.h) or as chapter5-base does ("legacy": a
+// bottleneck link per flow, Ipv4AddressHelper and global routing), then
+// simulates them for duration seconds (flows start during the first
+// half). Prints one line:
+//   topology flows setup[s] run[s] events maxrss-after-setup[KiB] maxrss[KiB]
+// e.g.
+//   ./waf --run "dumbbell-bench --num_flows=1000"
+//   ./waf --run "dumbbell-bench --num_flows=10000 --topology=legacy"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/traffic-control-module.h"
+
+#include "dumbbell.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DumbbellBench");
+
+static long
+GetMaxRss (void)
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Topology of chapter5-base: one access and one bottleneck link per flow.
+static void
+BuildLegacy (uint32_t num_flows, PointToPointHelper &local_link, PointToPointHelper &bottle_link,
+             uint32_t tcp_adu_size, double stop_time)
+{
+  NodeContainer gateways;
+  gateways.Create (1);
+  NodeContainer sources;
+  sources.Create (num_flows);
+  NodeContainer sinks;
+  sinks.Create (num_flows);
+
+  InternetStackHelper stack;
+  stack.InstallAll ();
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.255.255.0");
+  Ipv4InterfaceContainer sink_interfaces;
+  for (uint32_t i = 0; i < num_flows; i++)
+    {
+      NetDeviceContainer devices = local_link.Install (sources.Get (i), gateways.Get (0));
+      address.NewNetwork ();
+      address.Assign (devices);
+
+      devices = bottle_link.Install (gateways.Get (0), sinks.Get (i));
+      address.NewNetwork ();
+      sink_interfaces.Add (address.Assign (devices).Get (1));
+    }
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  uint16_t port = 50000;
+  PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+  sink.Install (sinks).Stop (Seconds (stop_time));
+  for (uint32_t i = 0; i < num_flows; i++)
+    {
+      BulkSendHelper ftp ("ns3::TcpSocketFactory", InetSocketAddress (sink_interfaces.GetAddress (i), port));
+      ftp.SetAttribute ("SendSize", UintegerValue (tcp_adu_size));
+      ApplicationContainer app = ftp.Install (sources.Get (i));
+      app.Start (Seconds (stop_time * i / num_flows / 2));
+      app.Stop (Seconds (stop_time));
+    }
+}
+
+int main (int argc, char *argv[])
+{
+  std::string topology = "dumbbell";
+  uint32_t num_flows = 1000;
+  std::string bandwidth = "1Gbps";
+  std::string delay = "10ms";
+  std::string access_bandwidth = "100Mbps";
+  std::string access_delay = "1ms";
+  double duration = 1;
+  uint32_t mtu_bytes = 1500;
+
+  CommandLine cmd;
+  cmd.AddValue ("topology", "Topology to build: dumbbell or legacy (chapter5-base)", topology);
+  cmd.AddValue ("num_flows", "Number of flows", num_flows);
+  cmd.AddValue ("bandwidth", "Bottleneck bandwidth", bandwidth);
+  cmd.AddValue ("delay", "Bottleneck delay", delay);
+  cmd.AddValue ("access_bandwidth", "Access link bandwidth", access_bandwidth);
+  cmd.AddValue ("access_delay", "Access link delay", access_delay);
+  cmd.AddValue ("duration", "Time to simulate in seconds", duration);
+  cmd.AddValue ("mtu", "Size of IP packets to send in bytes", mtu_bytes);
+  cmd.Parse (argc, argv);
+
+  uint32_t tcp_adu_size = mtu_bytes - 20 - 40;
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (tcp_adu_size));
+
+  PointToPointHelper local_link;
+  local_link.SetDeviceAttribute ("DataRate", StringValue (access_bandwidth));
+  local_link.SetChannelAttribute ("Delay", StringValue (access_delay));
+  PointToPointHelper bottle_link;
+  bottle_link.SetDeviceAttribute ("DataRate", StringValue (bandwidth));
+  bottle_link.SetChannelAttribute ("Delay", StringValue (delay));
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  if (topology == "dumbbell")
+    {
+      DumbbellHelper dumbbell (local_link, bottle_link);
+      dumbbell.Install (num_flows);
+
+      TrafficControlHelper tch;
+      tch.SetRootQueueDisc ("ns3::PfifoFastQueueDisc");
+      tch.Install (dumbbell.GetBottleneck ());
+
+      dumbbell.InstallSinks (50000).Stop (Seconds (duration));
+      ApplicationContainer apps = dumbbell.InstallBulkSenders (50000, tcp_adu_size, 0);
+      for (uint32_t i = 0; i < apps.GetN (); i++)
+        {
+          apps.Get (i)->SetStartTime (Seconds (duration * i / num_flows / 2));
+        }
+      apps.Stop (Seconds (duration));
+    }
+  else if (topology == "legacy")
+    {
+      BuildLegacy (num_flows, local_link, bottle_link, tcp_adu_size, duration);
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown topology " << topology);
+    }
+  double setup = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  long setup_rss = GetMaxRss ();
+
+  start = std::chrono::steady_clock::now ();
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  double run = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  std::cout << topology << " " << num_flows << " " << setup << " " << run << " "
+            << Simulator::GetEventCount () << " " << setup_rss << " " << GetMaxRss () << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,337 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Dumbbell topology for many flows, shared by the scratch programs.
+//
+//   sender 0 --+                          +-- receiver 0
+//   sender 1 --+-- left ==bottleneck== right --+-- receiver 1
+//      ...     |                          |       ...
+//
+// Every sender and receiver has its own access link to its router, and
+// all flows share the one bottleneck link between the routers. Flow i
+// goes from sender i to receiver i.
+//
+// The topology is built to set up quickly with thousands of flows:
+//  - addresses are computed, not allocated: access link i of the senders
+//    is 10.0.0.0/30 + 4*i (router .1, host .2), of the receivers
+//    10.64.0.0/30 + 4*i, and the bottleneck is 10.128.0.0/30;
+//  - hosts have a single default route to their router;
+//  - routers use DumbbellRouting, which finds the access link of a host
+//    from its address in constant time, instead of global routing (whose
+//    tables hold a route per host and are built for all node pairs).
+// No queue discs are installed; install them (e.g. on GetBottleneck ())
+// with a TrafficControlHelper as needed.
+
+#ifndef DUMBBELL_H
+#define DUMBBELL_H
+
+#include <vector>
+
+#include "ns3/application-container.h"
+#include "ns3/bulk-send-helper.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4-static-routing.h"
+#include "ns3/ipv4-static-routing-helper.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node.h"
+#include "ns3/node-container.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+// Routing of a dumbbell router: hosts of its own side are reached on
+// their access links, all other addresses over the bottleneck.
+class DumbbellRouting : public Ipv4RoutingProtocol
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::DumbbellRouting")
+      .SetParent<Ipv4RoutingProtocol> ()
+      .SetGroupName ("Internet");
+    return tid;
+  }
+
+  // Hosts are at base + 4*i + 2; others are reached via gateway.
+  DumbbellRouting (Ipv4Address base, uint32_t bottleneck, Ipv4Address gateway)
+    : m_base (base),
+      m_bottleneck (bottleneck),
+      m_gateway (gateway)
+  {
+  }
+
+  // Interface of the access link of the next host.
+  void AddHost (uint32_t interface)
+  {
+    m_hosts.push_back (interface);
+  }
+
+  virtual Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
+                                      Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+  {
+    Ptr<Ipv4Route> route = Lookup (header.GetDestination ());
+    sockerr = route ? Socket::ERROR_NOTERROR : Socket::ERROR_NOROUTETOHOST;
+    return route;
+  }
+
+  virtual bool RouteInput (Ptr<const Packet> p, const Ipv4Header &header,
+                           Ptr<const NetDevice> idev, UnicastForwardCallback ucb,
+                           MulticastForwardCallback mcb, LocalDeliverCallback lcb,
+                           ErrorCallback ecb)
+  {
+    // Local delivery is done by Ipv4ListRouting before asking us.
+    Ptr<Ipv4Route> route = Lookup (header.GetDestination ());
+    if (!route)
+      {
+        return false;
+      }
+    ucb (route, p, header);
+    return true;
+  }
+
+  virtual void NotifyInterfaceUp (uint32_t interface)
+  {
+  }
+
+  virtual void NotifyInterfaceDown (uint32_t interface)
+  {
+  }
+
+  virtual void NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+  }
+
+  virtual void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+  }
+
+  virtual void SetIpv4 (Ptr<Ipv4> ipv4)
+  {
+    m_ipv4 = ipv4;
+  }
+
+  virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const
+  {
+    *stream->GetStream () << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+                          << ", dumbbell router: " << m_hosts.size () << " hosts from "
+                          << m_base << ", others via " << m_gateway << std::endl;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_ipv4 = 0;
+    Ipv4RoutingProtocol::DoDispose ();
+  }
+
+private:
+  Ptr<Ipv4Route> Lookup (Ipv4Address destination) const
+  {
+    uint32_t offset = destination.Get () - m_base.Get ();
+    uint32_t interface = m_bottleneck;
+    Ipv4Address gateway = m_gateway;
+    if (offset / 4 < m_hosts.size () && offset % 4 == 2)
+      {
+        interface = m_hosts[offset / 4];
+        gateway = Ipv4Address::GetZero ();
+      }
+    else if (destination.IsBroadcast () || destination.IsMulticast ())
+      {
+        return 0;
+      }
+
+    Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+    route->SetDestination (destination);
+    route->SetGateway (gateway);
+    route->SetSource (m_ipv4->GetAddress (interface, 0).GetLocal ());
+    route->SetOutputDevice (m_ipv4->GetNetDevice (interface));
+    return route;
+  }
+
+  Ptr<Ipv4> m_ipv4;              // IP of the router.
+  Ipv4Address m_base;            // Network of access link 0.
+  uint32_t m_bottleneck;         // Interface of the bottleneck.
+  Ipv4Address m_gateway;         // Other router.
+  std::vector<uint32_t> m_hosts; // Interface of each host.
+};
+
+class DumbbellHelper
+{
+public:
+  // Links are created with the given helpers.
+  DumbbellHelper (const PointToPointHelper &access, const PointToPointHelper &bottleneck)
+    : m_access (access),
+      m_bottleneck (bottleneck)
+  {
+  }
+
+  // Create routers, flows senders and receivers, and their links.
+  void Install (uint32_t flows)
+  {
+    m_routers.Create (2);
+    m_senders.Create (flows);
+    m_receivers.Create (flows);
+
+    InternetStackHelper stack;
+    stack.Install (m_routers);
+    stack.Install (m_senders);
+    stack.Install (m_receivers);
+
+    Ipv4Mask mask ("255.255.255.252");
+    Ipv4Address bottleneck ("10.128.0.0");
+    m_bottleneckDevices = m_bottleneck.Install (m_routers);
+    uint32_t left = AddInterface (m_bottleneckDevices.Get (0), Offset (bottleneck, 1), mask);
+    uint32_t right = AddInterface (m_bottleneckDevices.Get (1), Offset (bottleneck, 2), mask);
+
+    Ipv4Address senders ("10.0.0.0");
+    Ipv4Address receivers ("10.64.0.0");
+    Ptr<DumbbellRouting> leftRouting = AddRouting (m_routers.Get (0), senders, left,
+                                                   Offset (bottleneck, 2));
+    Ptr<DumbbellRouting> rightRouting = AddRouting (m_routers.Get (1), receivers, right,
+                                                    Offset (bottleneck, 1));
+    for (uint32_t i = 0; i < flows; i++)
+      {
+        leftRouting->AddHost (AddHost (m_senders.Get (i), m_routers.Get (0),
+                                       Offset (senders, 4 * i)));
+        rightRouting->AddHost (AddHost (m_receivers.Get (i), m_routers.Get (1),
+                                        Offset (receivers, 4 * i)));
+      }
+  }
+
+  // Install one PacketSink on each receiver.
+  ApplicationContainer InstallSinks (uint16_t port) const
+  {
+    PacketSinkHelper sink ("ns3::TcpSocketFactory",
+                           InetSocketAddress (Ipv4Address::GetAny (), port));
+    return sink.Install (m_receivers);
+  }
+
+  // Install a BulkSendApplication on each sender, to its receiver.
+  ApplicationContainer InstallBulkSenders (uint16_t port, uint32_t sendSize,
+                                           uint64_t maxBytes) const
+  {
+    ApplicationContainer apps;
+    for (uint32_t i = 0; i < m_senders.GetN (); i++)
+      {
+        BulkSendHelper ftp ("ns3::TcpSocketFactory", InetSocketAddress (GetReceiverAddress (i), port));
+        ftp.SetAttribute ("SendSize", UintegerValue (sendSize));
+        ftp.SetAttribute ("MaxBytes", UintegerValue (maxBytes));
+        apps.Add (ftp.Install (m_senders.Get (i)));
+      }
+    return apps;
+  }
+
+  Ptr<Node> GetLeft (void) const
+  {
+    return m_routers.Get (0);
+  }
+
+  Ptr<Node> GetRight (void) const
+  {
+    return m_routers.Get (1);
+  }
+
+  NodeContainer GetSenders (void) const
+  {
+    return m_senders;
+  }
+
+  NodeContainer GetReceivers (void) const
+  {
+    return m_receivers;
+  }
+
+  // Devices of the bottleneck on the left and right router.
+  NetDeviceContainer GetBottleneck (void) const
+  {
+    return m_bottleneckDevices;
+  }
+
+  Ipv4Address GetSenderAddress (uint32_t i) const
+  {
+    return Offset (Ipv4Address ("10.0.0.0"), 4 * i + 2);
+  }
+
+  Ipv4Address GetReceiverAddress (uint32_t i) const
+  {
+    return Offset (Ipv4Address ("10.64.0.0"), 4 * i + 2);
+  }
+
+private:
+  static Ipv4Address Offset (Ipv4Address base, uint32_t offset)
+  {
+    return Ipv4Address (base.Get () + offset);
+  }
+
+  // Add device with address to its node's IP, as Ipv4AddressHelper does
+  // but without the address bookkeeping; returns the interface.
+  static uint32_t AddInterface (Ptr<NetDevice> device, Ipv4Address address, Ipv4Mask mask)
+  {
+    Ptr<Ipv4> ipv4 = device->GetNode ()->GetObject<Ipv4> ();
+    int32_t interface = ipv4->GetInterfaceForDevice (device);
+    if (interface == -1)
+      {
+        interface = ipv4->AddInterface (device);
+      }
+    ipv4->AddAddress (interface, Ipv4InterfaceAddress (address, mask));
+    ipv4->SetMetric (interface, 1);
+    ipv4->SetUp (interface);
+    return interface;
+  }
+
+  static Ptr<DumbbellRouting> AddRouting (Ptr<Node> router, Ipv4Address hosts,
+                                          uint32_t bottleneck, Ipv4Address gateway)
+  {
+    Ptr<Ipv4> ipv4 = router->GetObject<Ipv4> ();
+    Ptr<DumbbellRouting> routing = CreateObject<DumbbellRouting> (hosts, bottleneck, gateway);
+    DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ())->AddRoutingProtocol (routing, 10);
+    return routing;
+  }
+
+  // Link host to router on network; returns the router's interface.
+  uint32_t AddHost (Ptr<Node> host, Ptr<Node> router, Ipv4Address network)
+  {
+    NetDeviceContainer devices = m_access.Install (router, host);
+    Ipv4Mask mask ("255.255.255.252");
+    uint32_t interface = AddInterface (devices.Get (0), Offset (network, 1), mask);
+    uint32_t hostInterface = AddInterface (devices.Get (1), Offset (network, 2), mask);
+
+    Ipv4StaticRoutingHelper helper;
+    helper.GetStaticRouting (host->GetObject<Ipv4> ())
+      ->SetDefaultRoute (Offset (network, 1), hostInterface);
+    return interface;
+  }
+
+  PointToPointHelper m_access;            // Access links.
+  PointToPointHelper m_bottleneck;        // Bottleneck link.
+  NodeContainer m_routers;                // Left and right router.
+  NodeContainer m_senders;                // Sender of each flow.
+  NodeContainer m_receivers;              // Receiver of each flow.
+  NetDeviceContainer m_bottleneckDevices; // Bottleneck devices.
+};
+
+} // namespace ns3
+
+#endif /* DUMBBELL_H */
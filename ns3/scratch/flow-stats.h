@@ -0,0 +1,425 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// In-simulation flow statistics shared by the scratch programs.
+//
+// A StatsCollector keeps streaming statistics of every flow while the
+// simulation runs, so that sweeps need not write and re-read full traces:
+//  - RTT and bytes in flight of each sender socket,
+//  - goodput of each flow per interval, from the PacketSink Rx traces
+//    (flows are told apart by the sender address),
+//  - Jain's fairness index of the goodputs, per interval and overall.
+// Distributions are kept in log-linear histograms (as HDR histograms do),
+// which give quantiles within 1/64 relative error in constant memory per
+// value range. Write () stores a small JSON summary after Simulator::Run.
+
+#ifndef FLOW_STATS_H
+#define FLOW_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ns3/address.h"
+#include "ns3/callback.h"
+#include "ns3/config.h"
+#include "ns3/fatal-error.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+
+namespace ns3 {
+
+// Log-linear histogram of non-negative values.
+class Histogram
+{
+public:
+  static const int SUB_BUCKETS = 32; // Buckets per power of two.
+
+  Histogram ()
+    : m_count (0),
+      m_zeros (0),
+      m_sum (0),
+      m_min (0),
+      m_max (0),
+      m_first (0)
+  {
+  }
+
+  void Add (double value)
+  {
+    if (m_count == 0 || value < m_min)
+      {
+        m_min = value;
+      }
+    if (m_count == 0 || value > m_max)
+      {
+        m_max = value;
+      }
+    m_count++;
+    m_sum += value;
+    if (value <= 0)
+      {
+        m_zeros++;
+        return;
+      }
+
+    int index = GetIndex (value);
+    if (m_counts.empty ())
+      {
+        m_first = index;
+      }
+    else if (index < m_first)
+      {
+        m_counts.insert (m_counts.begin (), m_first - index, 0);
+        m_first = index;
+      }
+    if (index - m_first >= (int) m_counts.size ())
+      {
+        m_counts.resize (index - m_first + 1, 0);
+      }
+    m_counts[index - m_first]++;
+  }
+
+  // Add all values of other.
+  void Add (const Histogram &other)
+  {
+    if (other.m_count == 0)
+      {
+        return;
+      }
+    if (m_count == 0 || other.m_min < m_min)
+      {
+        m_min = other.m_min;
+      }
+    if (m_count == 0 || other.m_max > m_max)
+      {
+        m_max = other.m_max;
+      }
+    m_count += other.m_count;
+    m_zeros += other.m_zeros;
+    m_sum += other.m_sum;
+    if (other.m_counts.empty ())
+      {
+        return;
+      }
+    if (m_counts.empty ())
+      {
+        m_first = other.m_first;
+      }
+    else if (other.m_first < m_first)
+      {
+        m_counts.insert (m_counts.begin (), m_first - other.m_first, 0);
+        m_first = other.m_first;
+      }
+    int last = other.m_first + other.m_counts.size ();
+    if (last - m_first > (int) m_counts.size ())
+      {
+        m_counts.resize (last - m_first, 0);
+      }
+    for (size_t i = 0; i < other.m_counts.size (); i++)
+      {
+        m_counts[other.m_first - m_first + i] += other.m_counts[i];
+      }
+  }
+
+  // Value below which a fraction q of the values lie.
+  double GetQuantile (double q) const
+  {
+    if (m_count == 0)
+      {
+        return 0;
+      }
+    uint64_t rank = std::max<uint64_t> (1, std::ceil (q * m_count));
+    uint64_t seen = m_zeros;
+    if (seen >= rank)
+      {
+        return m_min;
+      }
+    for (size_t i = 0; i < m_counts.size (); i++)
+      {
+        seen += m_counts[i];
+        if (seen >= rank)
+          {
+            double value = (GetLower (m_first + i) + GetLower (m_first + i + 1)) / 2;
+            return std::min (std::max (value, m_min), m_max);
+          }
+      }
+    return m_max;
+  }
+
+  uint64_t GetCount (void) const
+  {
+    return m_count;
+  }
+
+  double GetMean (void) const
+  {
+    return m_count > 0 ? m_sum / m_count : 0;
+  }
+
+  // Summary as a JSON object, values multiplied by scale.
+  std::string ToJson (double scale) const
+  {
+    char buf[256];
+    std::snprintf (buf, sizeof (buf),
+                   "{\"count\": %llu, \"mean\": %g, \"min\": %g, \"p50\": %g, "
+                   "\"p90\": %g, \"p99\": %g, \"max\": %g}",
+                   (unsigned long long) m_count, GetMean () * scale, m_min * scale,
+                   GetQuantile (0.5) * scale, GetQuantile (0.9) * scale,
+                   GetQuantile (0.99) * scale, m_max * scale);
+    return buf;
+  }
+
+private:
+  static int GetIndex (double value)
+  {
+    int exp;
+    double mantissa = std::frexp (value, &exp); // In [0.5, 1).
+    return exp * SUB_BUCKETS + (int) ((mantissa - 0.5) * 2 * SUB_BUCKETS);
+  }
+
+  // Lowest value of bucket index.
+  static double GetLower (int index)
+  {
+    int exp = index >= 0 ? index / SUB_BUCKETS : -((-index - 1) / SUB_BUCKETS) - 1;
+    int sub = index - exp * SUB_BUCKETS;
+    return std::ldexp (0.5 + 0.5 * sub / SUB_BUCKETS, exp);
+  }
+
+  uint64_t m_count;               // Values added.
+  uint64_t m_zeros;               // Values not above 0.
+  double m_sum;                   // Sum of values.
+  double m_min;                   // Smallest value.
+  double m_max;                   // Largest value.
+  int m_first;                    // Bucket index of m_counts[0].
+  std::vector<uint64_t> m_counts; // Values in each bucket.
+};
+
+// Statistics of one flow.
+class FlowStats : public SimpleRefCount<FlowStats>
+{
+public:
+  FlowStats ()
+    : m_flow (-1),
+      m_bytes (0),
+      m_intervalBytes (0)
+  {
+  }
+
+  int32_t m_flow;           // Flow index (-1 if sender not known).
+  Time m_start;             // Time sender was connected.
+  uint64_t m_bytes;         // Bytes received.
+  uint64_t m_intervalBytes; // Bytes received in current interval.
+  Histogram m_rtt;          // RTT samples (s).
+  Histogram m_inFlight;     // Bytes in flight.
+  Histogram m_goodput;      // Goodput of each interval (bit/s).
+};
+
+class StatsCollector : public SimpleRefCount<StatsCollector>
+{
+public:
+  // Start collecting goodput of all PacketSinks, every interval.
+  StatsCollector (Time interval)
+    : m_interval (interval)
+  {
+    if (!interval.IsStrictlyPositive ())
+      {
+        NS_FATAL_ERROR ("Stats interval must be positive");
+      }
+    Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx",
+                                   MakeBoundCallback (&RxTracer, Ptr<StatsCollector> (this)));
+    Simulator::Schedule (m_interval, &StatsCollector::EndInterval, Ptr<StatsCollector> (this));
+  }
+
+  // Collect RTT and in-flight of flow; call once the socket exists.
+  void AddSender (uint32_t flow, uint32_t nodeId, uint32_t socketId)
+  {
+    std::string path = "/NodeList/" + std::to_string (nodeId)
+      + "/$ns3::TcpL4Protocol/SocketList/" + std::to_string (socketId);
+    Config::MatchContainer match = Config::LookupMatches (path);
+    if (match.GetN () == 0)
+      {
+        NS_FATAL_ERROR ("No socket at " << path);
+      }
+    Address local;
+    match.Get (0)->GetObject<Socket> ()->GetSockName (local);
+
+    Ptr<FlowStats> stats = GetFlow (local);
+    stats->m_flow = flow;
+    stats->m_start = Simulator::Now ();
+    Config::ConnectWithoutContext (path + "/RTT", MakeBoundCallback (&RttTracer, stats));
+    Config::ConnectWithoutContext (path + "/BytesInFlight", MakeBoundCallback (&InFlightTracer, stats));
+  }
+
+  // Write JSON summary of all flows with a known sender.
+  void Write (const std::string &fileName) const
+  {
+    std::FILE *f = std::fopen (fileName.c_str (), "w");
+    if (f == 0)
+      {
+        NS_FATAL_ERROR ("Cannot open stats file " << fileName);
+      }
+
+    std::vector<Ptr<FlowStats> > flows = GetSenders ();
+    std::vector<double> goodputs;
+    std::fprintf (f, "{\n  \"time\": %g,\n  \"interval\": %g,\n  \"flows\": [",
+                  Simulator::Now ().GetSeconds (), m_interval.GetSeconds ());
+    for (size_t i = 0; i < flows.size (); i++)
+      {
+        Ptr<FlowStats> s = flows[i];
+        double active = (Simulator::Now () - s->m_start).GetSeconds ();
+        double goodput = active > 0 ? s->m_bytes * 8 / active : 0;
+        goodputs.push_back (goodput);
+        std::fprintf (f, "%s\n    {\"flow\": %d, \"rx_bytes\": %llu, \"goodput_mbps\": %g,\n"
+                      "     \"rtt_ms\": %s,\n     \"inflight_bytes\": %s,\n"
+                      "     \"interval_goodput_mbps\": %s}",
+                      i > 0 ? "," : "", s->m_flow, (unsigned long long) s->m_bytes,
+                      goodput / 1e6, s->m_rtt.ToJson (1e3).c_str (),
+                      s->m_inFlight.ToJson (1).c_str (), s->m_goodput.ToJson (1e-6).c_str ());
+      }
+    std::fprintf (f, "\n  ],\n  \"jain\": %g,\n  \"interval_jain\": %s\n}\n",
+                  GetJain (goodputs), m_jain.ToJson (1).c_str ());
+    std::fclose (f);
+  }
+
+  // Names of the values of GetSummary ().
+  static std::vector<std::string> GetSummaryNames (void)
+  {
+    std::vector<std::string> names;
+    names.push_back ("goodput_mbps");
+    names.push_back ("jain");
+    names.push_back ("rtt_mean_ms");
+    names.push_back ("rtt_p99_ms");
+    return names;
+  }
+
+  // Total goodput, Jain's index of the goodputs, and the mean and 99th
+  // percentile of the RTT samples of all flows.
+  std::vector<double> GetSummary (void) const
+  {
+    std::vector<Ptr<FlowStats> > flows = GetSenders ();
+    std::vector<double> goodputs;
+    double total = 0;
+    Histogram rtt;
+    for (size_t i = 0; i < flows.size (); i++)
+      {
+        double active = (Simulator::Now () - flows[i]->m_start).GetSeconds ();
+        goodputs.push_back (active > 0 ? flows[i]->m_bytes * 8 / active : 0);
+        total += goodputs.back ();
+        rtt.Add (flows[i]->m_rtt);
+      }
+    std::vector<double> summary;
+    summary.push_back (total / 1e6);
+    summary.push_back (GetJain (goodputs));
+    summary.push_back (rtt.GetMean () * 1e3);
+    summary.push_back (rtt.GetQuantile (0.99) * 1e3);
+    return summary;
+  }
+
+  // Jain's fairness index of values (1 when all equal).
+  static double GetJain (const std::vector<double> &values)
+  {
+    double sum = 0, squares = 0;
+    for (size_t i = 0; i < values.size (); i++)
+      {
+        sum += values[i];
+        squares += values[i] * values[i];
+      }
+    return squares > 0 ? sum * sum / (values.size () * squares) : 0;
+  }
+
+private:
+  static void RxTracer (Ptr<StatsCollector> c, Ptr<const Packet> p, const Address &from)
+  {
+    Ptr<FlowStats> stats = c->GetFlow (from);
+    stats->m_bytes += p->GetSize ();
+    stats->m_intervalBytes += p->GetSize ();
+  }
+
+  static void RttTracer (Ptr<FlowStats> s, Time oldval, Time newval)
+  {
+    s->m_rtt.Add (newval.GetSeconds ());
+  }
+
+  static void InFlightTracer (Ptr<FlowStats> s, uint32_t oldval, uint32_t newval)
+  {
+    s->m_inFlight.Add (newval);
+  }
+
+  // Goodput and fairness of the interval just ended.
+  void EndInterval (void)
+  {
+    std::vector<Ptr<FlowStats> > flows = GetSenders ();
+    std::vector<double> goodputs;
+    for (size_t i = 0; i < flows.size (); i++)
+      {
+        double goodput = flows[i]->m_intervalBytes * 8 / m_interval.GetSeconds ();
+        flows[i]->m_goodput.Add (goodput);
+        flows[i]->m_intervalBytes = 0;
+        goodputs.push_back (goodput);
+      }
+    if (!goodputs.empty ())
+      {
+        m_jain.Add (GetJain (goodputs));
+      }
+    Simulator::Schedule (m_interval, &StatsCollector::EndInterval, Ptr<StatsCollector> (this));
+  }
+
+  Ptr<FlowStats> GetFlow (const Address &address)
+  {
+    Ptr<FlowStats> &stats = m_flows[address];
+    if (!stats)
+      {
+        stats = Create<FlowStats> ();
+      }
+    return stats;
+  }
+
+  // Flows with a known sender, by flow index.
+  std::vector<Ptr<FlowStats> > GetSenders (void) const
+  {
+    std::map<int32_t, Ptr<FlowStats> > senders;
+    for (std::map<Address, Ptr<FlowStats> >::const_iterator it = m_flows.begin ();
+         it != m_flows.end (); ++it)
+      {
+        if (it->second->m_flow >= 0)
+          {
+            senders[it->second->m_flow] = it->second;
+          }
+      }
+    std::vector<Ptr<FlowStats> > flows;
+    for (std::map<int32_t, Ptr<FlowStats> >::const_iterator it = senders.begin ();
+         it != senders.end (); ++it)
+      {
+        flows.push_back (it->second);
+      }
+    return flows;
+  }
+
+  Time m_interval;                               // Goodput interval.
+  std::map<Address, Ptr<FlowStats> > m_flows;    // Flows by sender address.
+  Histogram m_jain;                              // Jain's index per interval.
+};
+
+} // namespace ns3
+
+#endif /* FLOW_STATS_H */
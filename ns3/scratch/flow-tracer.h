@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Per-flow TCP socket tracing shared by the scratch programs.
+//
+// A FlowTracer holds the trace state of one flow and is bound to the
+// socket trace sources with MakeBoundCallback, so any number of flows can
+// be traced in one run. Each flow can write:
+//  - per-metric files <base><metric>.data ("time value", as before),
+//  - one columnar file <base>all.data with a row per change,
+//  - rows into a merged file shared by all flows (see CreateMerged).
+// Columns of a row, after the time, are given by Metric. Rows of the
+// merged file have the flow index in front of them.
+
+#ifndef FLOW_TRACER_H
+#define FLOW_TRACER_H
+
+#include <algorithm>
+#include <string>
+
+#include "ns3/callback.h"
+#include "ns3/config.h"
+#include "ns3/sequence-number.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/tcp-socket-base.h"
+
+#include "trace-sink.h"
+
+namespace ns3 {
+
+class FlowTracer : public SimpleRefCount<FlowTracer>
+{
+public:
+  // Traced metrics, in column order.
+  enum Metric
+  {
+    CWND, SSTH, RTT, RTO, NEXT_TX, INFLIGHT, NEXT_RX, ACK, CONG_STATE,
+    METRICS
+  };
+
+  static const size_t BUFFER_SIZE = 1 << 16; // Bytes buffered per file.
+
+  // Name of metric in per-metric file names.
+  static const char *GetName (Metric m)
+  {
+    static const char *names[METRICS] = {
+      "cwnd", "ssth", "rtt", "rto", "next-tx", "inflight", "next-rx", "ack",
+      "cong-state"
+    };
+    return names[m];
+  }
+
+  // Column kinds of a row.
+  static std::string GetColumns (void)
+  {
+    return "uudduuuuu";
+  }
+
+  // Create file for rows of all flows. It is keyed by the flow index, so
+  // bucket and change modes reduce the rows of each flow on their own.
+  static Ptr<TraceSink> CreateMerged (const std::string &fileName,
+                                      const TraceSink::Options &options)
+  {
+    return Create<TraceSink> (fileName, "u" + GetColumns (), options,
+                              TraceSink::BUFFER_SIZE, true);
+  }
+
+  // Files are named <base><metric>.data; merged may be 0.
+  FlowTracer (uint32_t flow, const std::string &base, const TraceSink::Options &options,
+              bool perMetric, bool columnar, Ptr<TraceSink> merged)
+    : m_flow (flow),
+      m_merged (merged)
+  {
+    for (int m = 0; m < METRICS; m++)
+      {
+        if (perMetric)
+          {
+            std::string kind = (m == RTT || m == RTO) ? "d" : "u";
+            m_sinks[m] = Create<TraceSink> (base + GetName (Metric (m)) + ".data",
+                                            kind, options, BUFFER_SIZE);
+          }
+        m_seen[m] = false;
+        m_values[m] = 0;
+      }
+    if (columnar)
+      {
+        m_columns = Create<TraceSink> (base + "all.data", GetColumns (),
+                                       options, BUFFER_SIZE);
+      }
+  }
+
+  // Connect to the sending socket; call once the socket exists.
+  void ConnectSender (uint32_t nodeId, uint32_t socketId)
+  {
+    std::string path = "/NodeList/" + std::to_string (nodeId)
+      + "/$ns3::TcpL4Protocol/SocketList/" + std::to_string (socketId);
+    Config::MatchContainer match = Config::LookupMatches (path);
+    if (match.GetN () == 0)
+      {
+        NS_FATAL_ERROR ("No socket at " << path);
+      }
+    match.Get (0)->GetObject<Socket> ()->GetSockName (m_local);
+
+    path += "/";
+    Ptr<FlowTracer> self (this);
+    Config::ConnectWithoutContext (path + "CongestionWindow", MakeBoundCallback (&CwndTracer, self));
+    Config::ConnectWithoutContext (path + "SlowStartThreshold", MakeBoundCallback (&SsThreshTracer, self));
+    Config::ConnectWithoutContext (path + "RTT", MakeBoundCallback (&RttTracer, self));
+    Config::ConnectWithoutContext (path + "RTO", MakeBoundCallback (&RtoTracer, self));
+    Config::ConnectWithoutContext (path + "NextTxSequence", MakeBoundCallback (&NextTxTracer, self));
+    Config::ConnectWithoutContext (path + "BytesInFlight", MakeBoundCallback (&InFlightTracer, self));
+    Config::ConnectWithoutContext (path + "HighestRxAck", MakeBoundCallback (&AckTracer, self));
+    Config::ConnectWithoutContext (path + "CongState", MakeBoundCallback (&CongStateTracer, self));
+  }
+
+  // Connect to the socket on nodeId accepted for this flow; call after
+  // ConnectSender. Retries until the connection has been accepted.
+  void ConnectReceiver (uint32_t nodeId)
+  {
+    Config::MatchContainer match = Config::LookupMatches (
+      "/NodeList/" + std::to_string (nodeId) + "/$ns3::TcpL4Protocol/SocketList/*");
+    for (uint32_t i = 0; i < match.GetN (); i++)
+      {
+        Address peer;
+        if (match.Get (i)->GetObject<Socket> ()->GetPeerName (peer) == 0
+            && peer == m_local)
+          {
+            Config::ConnectWithoutContext (match.GetMatchedPath (i) + "/RxBuffer/NextRxSequence",
+                                           MakeBoundCallback (&NextRxTracer, Ptr<FlowTracer> (this)));
+            return;
+          }
+      }
+    Simulator::Schedule (Seconds (0.1), &FlowTracer::ConnectReceiver, Ptr<FlowTracer> (this), nodeId);
+  }
+
+private:
+  static void CwndTracer (Ptr<FlowTracer> t, uint32_t oldval, uint32_t newval)
+  {
+    t->Update (CWND, oldval, newval, true);
+  }
+
+  static void SsThreshTracer (Ptr<FlowTracer> t, uint32_t oldval, uint32_t newval)
+  {
+    t->Update (SSTH, oldval, newval, true);
+  }
+
+  static void RttTracer (Ptr<FlowTracer> t, Time oldval, Time newval)
+  {
+    t->Update (RTT, oldval.GetSeconds (), newval.GetSeconds (), true);
+  }
+
+  static void RtoTracer (Ptr<FlowTracer> t, Time oldval, Time newval)
+  {
+    t->Update (RTO, oldval.GetSeconds (), newval.GetSeconds (), true);
+  }
+
+  static void NextTxTracer (Ptr<FlowTracer> t, SequenceNumber32 old, SequenceNumber32 nextTx)
+  {
+    t->Update (NEXT_TX, old.GetValue (), nextTx.GetValue (), false);
+  }
+
+  static void InFlightTracer (Ptr<FlowTracer> t, uint32_t old, uint32_t inFlight)
+  {
+    t->Update (INFLIGHT, old, inFlight, false);
+  }
+
+  static void NextRxTracer (Ptr<FlowTracer> t, SequenceNumber32 old, SequenceNumber32 nextRx)
+  {
+    t->Update (NEXT_RX, old.GetValue (), nextRx.GetValue (), false);
+  }
+
+  static void AckTracer (Ptr<FlowTracer> t, SequenceNumber32 old, SequenceNumber32 newAck)
+  {
+    t->Update (ACK, old.GetValue (), newAck.GetValue (), false);
+  }
+
+  static void CongStateTracer (Ptr<FlowTracer> t, TcpSocketState::TcpCongState_t old,
+                               TcpSocketState::TcpCongState_t newState)
+  {
+    t->Update (CONG_STATE, old, newState, false);
+  }
+
+  // Record new value of metric m. The first change of a metric with
+  // initial also writes the old value at time 0.
+  void Update (Metric m, double oldval, double newval, bool initial)
+  {
+    if (m_sinks[m])
+      {
+        if (!m_seen[m] && initial)
+          {
+            m_sinks[m]->Write (Seconds (0), oldval);
+          }
+        m_sinks[m]->Write (newval);
+
+        // Keep cwnd and ssthresh plots stepping together.
+        Metric other = m == CWND ? SSTH : m == SSTH ? CWND : METRICS;
+        if (other != METRICS && m_seen[other])
+          {
+            m_sinks[other]->Write (m_values[other]);
+          }
+      }
+    m_seen[m] = true;
+    m_values[m] = newval;
+
+    if (m_columns)
+      {
+        m_columns->WriteRow (Simulator::Now (), m_values);
+      }
+    if (m_merged)
+      {
+        double row[METRICS + 1];
+        row[0] = m_flow;
+        std::copy (m_values, m_values + METRICS, row + 1);
+        m_merged->WriteRow (Simulator::Now (), row);
+      }
+  }
+
+  uint32_t m_flow;                  // Flow index.
+  Address m_local;                  // Address of sending socket.
+  Ptr<TraceSink> m_sinks[METRICS];  // Per-metric files (or 0).
+  Ptr<TraceSink> m_columns;         // Columnar file (or 0).
+  Ptr<TraceSink> m_merged;          // File shared by all flows (or 0).
+  bool m_seen[METRICS];             // Metric has changed once.
+  double m_values[METRICS];         // Latest value of each metric.
+};
+
+} // namespace ns3
+
+#endif /* FLOW_TRACER_H */
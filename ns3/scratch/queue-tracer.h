@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Event-driven queue tracing shared by the scratch programs.
+//
+// A QueueTracer is hooked to the Enqueue, Dequeue and Drop trace sources
+// of a device queue and logs every occupancy change, with the sojourn
+// time of each dequeued packet. The queue is assumed to be FIFO with
+// drops on arrival (drop-tail), as the point-to-point device queues are.
+//
+// Records are kept in a ring of RING_SIZE records, written out whenever
+// it wraps and when the tracer is destroyed. With a sampling ratio of n,
+// only every n-th enqueue and every n-th dequeue is logged, each counted on
+// its own; drops are always logged.
+//
+// File format: 8-byte header ("NS3Q", version 1, 3 zero bytes), then
+// 24-byte records in host byte order: time (int64, ns), sojourn (int64,
+// ns; ENQUEUE or DROP for those events), packets and bytes in the queue
+// after the event (uint32 each). Convert it to text with
+//   python3 trace2txt.py --in-place <file>...
+
+#ifndef QUEUE_TRACER_H
+#define QUEUE_TRACER_H
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ns3/callback.h"
+#include "ns3/fatal-error.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+class QueueTracer : public SimpleRefCount<QueueTracer>
+{
+public:
+  static const size_t RING_SIZE = 1 << 16; // Records kept before writing.
+
+  // Sojourn field of records that are not dequeues.
+  static const int64_t ENQUEUE = -1;
+  static const int64_t DROP = -2;
+
+  QueueTracer (const std::string &fileName, uint32_t sample)
+    : m_sample (sample > 0 ? sample : 1),
+      m_enqueues (0),
+      m_dequeues (0),
+      m_packets (0),
+      m_bytes (0),
+      m_ring (RING_SIZE),
+      m_used (0)
+  {
+    m_file = std::fopen (fileName.c_str (), "wb");
+    if (m_file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot open trace file " << fileName);
+      }
+    char header[8] = { 'N', 'S', '3', 'Q', 1, 0, 0, 0 };
+    std::fwrite (header, 1, sizeof (header), m_file);
+  }
+
+  ~QueueTracer ()
+  {
+    WriteRing ();
+    std::fclose (m_file);
+  }
+
+  // Start tracing queue, which should be empty.
+  void Attach (Ptr<Queue<Packet> > queue)
+  {
+    Ptr<QueueTracer> self (this);
+    queue->TraceConnectWithoutContext ("Enqueue", MakeBoundCallback (&EnqueueTracer, self));
+    queue->TraceConnectWithoutContext ("Dequeue", MakeBoundCallback (&DequeueTracer, self));
+    queue->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&DropTracer, self));
+  }
+
+private:
+  struct Record
+  {
+    int64_t time;     // Time of event in ns.
+    int64_t sojourn;  // Sojourn time in ns, or ENQUEUE/DROP.
+    uint32_t packets; // Packets in queue after event.
+    uint32_t bytes;   // Bytes in queue after event.
+  };
+
+  static void EnqueueTracer (Ptr<QueueTracer> t, Ptr<const Packet> p)
+  {
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    t->m_arrivals.push_back (now);
+    t->m_packets++;
+    t->m_bytes += p->GetSize ();
+    if (t->m_enqueues++ % t->m_sample == 0)
+      {
+        t->Log (now, ENQUEUE);
+      }
+  }
+
+  static void DequeueTracer (Ptr<QueueTracer> t, Ptr<const Packet> p)
+  {
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    int64_t sojourn = 0;
+    if (!t->m_arrivals.empty ())
+      {
+        sojourn = now - t->m_arrivals.front ();
+        t->m_arrivals.pop_front ();
+        t->m_packets--;
+        t->m_bytes -= p->GetSize ();
+      }
+    if (t->m_dequeues++ % t->m_sample == 0)
+      {
+        t->Log (now, sojourn);
+      }
+  }
+
+  static void DropTracer (Ptr<QueueTracer> t, Ptr<const Packet> p)
+  {
+    t->Log (Simulator::Now ().GetNanoSeconds (), DROP);
+  }
+
+  void Log (int64_t now, int64_t sojourn)
+  {
+    Record &r = m_ring[m_used++];
+    r.time = now;
+    r.sojourn = sojourn;
+    r.packets = m_packets;
+    r.bytes = m_bytes;
+    if (m_used == m_ring.size ())
+      {
+        WriteRing ();
+      }
+  }
+
+  void WriteRing (void)
+  {
+    std::fwrite (&m_ring[0], sizeof (Record), m_used, m_file);
+    m_used = 0;
+  }
+
+  std::FILE *m_file;              // Log file.
+  uint32_t m_sample;              // Log every m_sample-th event.
+  uint64_t m_enqueues;            // Enqueues seen.
+  uint64_t m_dequeues;            // Dequeues seen.
+  uint32_t m_packets;             // Packets in queue.
+  uint32_t m_bytes;               // Bytes in queue.
+  std::deque<int64_t> m_arrivals; // Enqueue time of queued packets.
+  std::vector<Record> m_ring;     // Records not yet written.
+  size_t m_used;                  // Records used in ring.
+};
+
+} // namespace ns3
+
+#endif /* QUEUE_TRACER_H */
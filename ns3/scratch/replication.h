@@ -0,0 +1,257 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Independent replications of a scratch program in forked processes.
+//
+// The ns-3 simulator is a process-wide singleton, so replications cannot
+// run in threads. Instead ReplicationPool::Fork () is called once the
+// command line has been parsed, before anything random is created: it
+// forks one child per replication (at most jobs at a time) and returns
+// the replication index in each child. The children share the loaded
+// libraries, registered TypeIds and parsed configuration with the parent
+// through copy-on-write. Each child runs its simulation and sends a few
+// summary values back through a pipe with Report (). Fork () returns -1
+// in the parent once all children have finished; WriteSummary () then
+// stores the mean, standard deviation and 95% confidence interval of each
+// value over the replications as JSON.
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ns3/fatal-error.h"
+
+namespace ns3 {
+
+class ReplicationPool
+{
+public:
+  ReplicationPool ()
+    : m_child (false),
+      m_fd (-1),
+      m_failures (0)
+  {
+  }
+
+  // Run count replications, jobs at a time. Returns the replication index
+  // in each child, and -1 in the parent after all children have exited.
+  int32_t Fork (uint32_t count, uint32_t jobs)
+  {
+    std::map<pid_t, std::pair<uint32_t, int> > running; // Index and pipe.
+    std::cout.flush ();
+    std::cerr.flush ();
+    m_results.assign (count, std::vector<double> ());
+
+    uint32_t next = 0;
+    while (next < count || !running.empty ())
+      {
+        if (next < count && running.size () < std::max<uint32_t> (jobs, 1))
+          {
+            int fds[2];
+            if (pipe (fds) != 0)
+              {
+                NS_FATAL_ERROR ("Cannot create pipe for replication " << next);
+              }
+            pid_t pid = fork ();
+            if (pid < 0)
+              {
+                NS_FATAL_ERROR ("Cannot fork replication " << next);
+              }
+            if (pid == 0)
+              {
+                for (std::map<pid_t, std::pair<uint32_t, int> >::iterator it = running.begin ();
+                     it != running.end (); ++it)
+                  {
+                    close (it->second.second);
+                  }
+                close (fds[0]);
+                m_child = true;
+                m_fd = fds[1];
+                return next;
+              }
+            close (fds[1]);
+            running[pid] = std::make_pair (next++, fds[0]);
+            continue;
+          }
+
+        int status;
+        pid_t pid = waitpid (-1, &status, 0);
+        if (pid < 0)
+          {
+            NS_FATAL_ERROR ("Lost replications");
+          }
+        if (running.find (pid) == running.end ())
+          {
+            continue;
+          }
+        uint32_t index = running[pid].first;
+        int fd = running[pid].second;
+        running.erase (pid);
+        if (!ReadResult (fd, m_results[index])
+            || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+          {
+            std::cerr << "Replication " << index << " failed" << std::endl;
+            m_results[index].clear ();
+            m_failures++;
+          }
+        close (fd);
+      }
+    return -1;
+  }
+
+  // In a child, send the summary values of the replication to the parent.
+  void Report (const std::vector<double> &values)
+  {
+    if (m_fd < 0)
+      {
+        return;
+      }
+    uint32_t n = values.size ();
+    bool ok = write (m_fd, &n, sizeof (n)) == sizeof (n);
+    if (ok && n > 0)
+      {
+        ssize_t size = n * sizeof (double);
+        ok = write (m_fd, &values[0], size) == size;
+      }
+    if (!ok)
+      {
+        NS_FATAL_ERROR ("Cannot report replication result");
+      }
+    close (m_fd);
+    m_fd = -1;
+  }
+
+  // True in the forked children.
+  bool IsChild (void) const
+  {
+    return m_child;
+  }
+
+  // Replications that did not exit normally with a result.
+  uint32_t GetFailures (void) const
+  {
+    return m_failures;
+  }
+
+  // In the parent, write statistics of each named value as JSON; firstRun
+  // is the run number of replication 0.
+  void WriteSummary (const std::string &fileName, const std::vector<std::string> &names,
+                     uint32_t firstRun) const
+  {
+    std::FILE *f = std::fopen (fileName.c_str (), "w");
+    if (f == 0)
+      {
+        NS_FATAL_ERROR ("Cannot open summary file " << fileName);
+      }
+    std::fprintf (f, "{\n  \"replications\": %u,\n  \"failures\": %u,\n  \"first_run\": %u,\n"
+                  "  \"metrics\": {", (uint32_t) m_results.size (), m_failures, firstRun);
+    for (size_t m = 0; m < names.size (); m++)
+      {
+        std::vector<double> values;
+        for (size_t i = 0; i < m_results.size (); i++)
+          {
+            if (m < m_results[i].size ())
+              {
+                values.push_back (m_results[i][m]);
+              }
+          }
+        double mean = 0, sd = 0;
+        for (size_t i = 0; i < values.size (); i++)
+          {
+            mean += values[i] / values.size ();
+          }
+        for (size_t i = 0; i < values.size (); i++)
+          {
+            sd += (values[i] - mean) * (values[i] - mean);
+          }
+        sd = values.size () > 1 ? std::sqrt (sd / (values.size () - 1)) : 0;
+        double ci = values.size () > 1 ? GetT95 (values.size () - 1) * sd / std::sqrt (values.size ()) : 0;
+
+        std::fprintf (f, "%s\n    \"%s\": {\"n\": %u, \"mean\": %g, \"sd\": %g, \"ci95\": %g, \"values\": [",
+                      m > 0 ? "," : "", names[m].c_str (), (uint32_t) values.size (), mean, sd, ci);
+        for (size_t i = 0; i < values.size (); i++)
+          {
+            std::fprintf (f, "%s%g", i > 0 ? ", " : "", values[i]);
+          }
+        std::fprintf (f, "]}");
+      }
+    std::fprintf (f, "\n  }\n}\n");
+    std::fclose (f);
+  }
+
+  // Two-sided 95% quantile of Student's t distribution.
+  static double GetT95 (uint32_t df)
+  {
+    static const double t[30] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df == 0)
+      {
+        return 0;
+      }
+    return df <= 30 ? t[df - 1] : 1.96 + 2.4 / df;
+  }
+
+private:
+  static bool ReadResult (int fd, std::vector<double> &values)
+  {
+    uint32_t n;
+    if (!ReadAll (fd, &n, sizeof (n)))
+      {
+        return false;
+      }
+    values.resize (n);
+    return n == 0 || ReadAll (fd, &values[0], n * sizeof (double));
+  }
+
+  static bool ReadAll (int fd, void *data, size_t size)
+  {
+    char *p = static_cast<char *> (data);
+    while (size > 0)
+      {
+        ssize_t got = read (fd, p, size);
+        if (got <= 0)
+          {
+            return false;
+          }
+        p += got;
+        size -= got;
+      }
+    return true;
+  }
+
+  bool m_child;                                // Forked replication.
+  int m_fd;                                    // Pipe to parent (child only).
+  uint32_t m_failures;                         // Failed replications.
+  std::vector<std::vector<double> > m_results; // Values of each replication.
+};
+
+} // namespace ns3
+
+#endif /* REPLICATION_H */
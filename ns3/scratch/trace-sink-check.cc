@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Checks of the reduction of a keyed TraceSink, as used for the merged
+// file of all flows (FlowTracer::CreateMerged).
+//
+// Writes rows of two flows into one keyed sink in bucket and in change
+// mode, reads the text file back and compares it with the rows each flow
+// would get on its own. Prints "ok", or the first mismatch and exits with
+// status 1, e.g.
+//   ./waf --run trace-sink-check
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "trace-sink.h"
+
+using namespace ns3;
+
+typedef std::vector<std::vector<double> > Rows;
+
+// One sample of a flow.
+struct Sample
+{
+  double time;
+  double flow;
+  double value;
+};
+
+static Rows
+WriteAndRead (const std::string &fileName, const std::string &mode,
+              const Sample *samples, size_t n)
+{
+  {
+    TraceSink::Options options (false, mode, MilliSeconds (100), 0.01);
+    TraceSink sink (fileName, "ud", options, TraceSink::BUFFER_SIZE, true);
+    for (size_t i = 0; i < n; i++)
+      {
+        double row[2] = { samples[i].flow, samples[i].value };
+        sink.WriteRow (Seconds (samples[i].time), row);
+      }
+  }
+
+  Rows rows;
+  std::ifstream in (fileName.c_str ());
+  std::string line;
+  while (std::getline (in, line))
+    {
+      std::istringstream fields (line);
+      std::vector<double> row;
+      double value;
+      while (fields >> value)
+        {
+          row.push_back (value);
+        }
+      rows.push_back (row);
+    }
+  std::remove (fileName.c_str ());
+  return rows;
+}
+
+static bool
+Check (const std::string &name, const Rows &rows, const Rows &expected)
+{
+  bool ok = rows.size () == expected.size ();
+  for (size_t i = 0; ok && i < rows.size (); i++)
+    {
+      ok = rows[i].size () == expected[i].size ();
+      for (size_t j = 0; ok && j < rows[i].size (); j++)
+        {
+          ok = std::fabs (rows[i][j] - expected[i][j]) < 1e-9;
+        }
+      if (!ok)
+        {
+          std::cerr << name << ": row " << i << " differs" << std::endl;
+        }
+    }
+  if (rows.size () != expected.size ())
+    {
+      std::cerr << name << ": " << rows.size () << " rows instead of "
+                << expected.size () << std::endl;
+    }
+  return ok;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string file_name = "trace-sink-check.data";
+
+  CommandLine cmd;
+  cmd.AddValue ("file_name", "Scratch trace file", file_name);
+  cmd.Parse (argc, argv);
+
+  // Both flows in the first bucket, flow 0 also in the second. A bucket
+  // row is: time, then the last, min, max and mean of flow and value.
+  const Sample bucketSamples[] = {
+    { 0.01, 0, 1 }, { 0.02, 1, 100 }, { 0.03, 0, 3 }, { 0.04, 1, 300 },
+    { 0.15, 0, 5 }
+  };
+  const double bucketRows[][9] = {
+    { 0.03, 0, 3, 0, 1, 0, 3, 0, 2 },
+    { 0.04, 1, 300, 1, 100, 1, 300, 1, 200 },
+    { 0.15, 0, 5, 0, 5, 0, 5, 0, 5 }
+  };
+  Rows expected;
+  for (size_t i = 0; i < 3; i++)
+    {
+      expected.push_back (std::vector<double> (bucketRows[i], bucketRows[i] + 9));
+    }
+  bool ok = Check ("bucket", WriteAndRead (file_name, "bucket", bucketSamples, 5), expected);
+
+  // The first value of flow 1 equals the last written one of flow 0 and
+  // must still be written; its repeat is held until the end. Flow 0 stays
+  // flat and then steps, so the end of the flat part is written before
+  // the step.
+  const Sample changeSamples[] = {
+    { 0.01, 0, 10 }, { 0.02, 1, 10 }, { 0.03, 1, 10 }, { 0.035, 0, 10 },
+    { 0.04, 0, 20 }
+  };
+  const double changeRows[][3] = {
+    { 0.01, 0, 10 }, { 0.02, 1, 10 }, { 0.035, 0, 10 }, { 0.04, 0, 20 },
+    { 0.03, 1, 10 }
+  };
+  expected.clear ();
+  for (size_t i = 0; i < 5; i++)
+    {
+      expected.push_back (std::vector<double> (changeRows[i], changeRows[i] + 3));
+    }
+  ok = Check ("change", WriteAndRead (file_name, "change", changeSamples, 5), expected) && ok;
+
+  std::cout << (ok ? "ok" : "failed") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,382 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Buffered trace file shared by the scratch programs.
+//
+// Each sample is a time followed by one or more column values. Samples are
+// kept in a large buffer and written out when it fills (and when the sink
+// is destroyed), instead of flushing the file on every sample as std::endl
+// does. Columns are given as a string with one kind per column: 'u' values
+// are written as integers, 'd' values as reals.
+//
+// Samples can be reduced as they are recorded (Options::mode):
+//  - ALL writes every sample.
+//  - BUCKET writes one row per time bucket that has samples: the time of
+//    the last sample, then the last, min, max and mean of each column.
+//    The first columns thus still hold the traced values.
+//  - CHANGE writes a sample only when a column has changed by more than
+//    epsilon (relative to the last written value), preceded by the last
+//    unchanged sample so that steps stay steps, and the last sample.
+// A keyed sink holds samples of several sources (e.g. flows) told apart by
+// the first column, and reduces the samples of each key on their own, so
+// the key column is written as it is. Held samples of all keys are written
+// in time order when the bucket ends (or at the end).
+//
+// Text format (default) is the "time value..." lines used for gnuplot.
+// Binary format is an 8-byte header ("NS3T", version 2, number of columns,
+// 2 zero bytes), the column kinds padded with zero bytes to a multiple of
+// 8, then records of time (int64, ns) and one double per column, in host
+// byte order. Convert it to the text format with
+//   python3 trace2txt.py --in-place <file>...
+
+#ifndef TRACE_SINK_H
+#define TRACE_SINK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/fatal-error.h"
+
+namespace ns3 {
+
+class TraceSink : public SimpleRefCount<TraceSink>
+{
+public:
+  static const size_t BUFFER_SIZE = 1 << 20; // Bytes buffered per file.
+  static const size_t COLUMN_MAX = 24;       // Max text bytes of one value.
+
+  // Reduction of samples.
+  enum Mode { ALL, BUCKET, CHANGE };
+
+  // Output options shared by the sinks of a run.
+  struct Options
+  {
+    Options ()
+      : binary (false),
+        mode (ALL),
+        bucket (MilliSeconds (100)),
+        epsilon (0.01)
+    {
+    }
+
+    // Mode given by name: "all", "bucket" or "change".
+    Options (bool binaryFormat, const std::string &modeName, Time width, double minChange)
+      : binary (binaryFormat),
+        mode (ALL),
+        bucket (width),
+        epsilon (minChange)
+    {
+      if (modeName == "bucket")
+        {
+          mode = BUCKET;
+        }
+      else if (modeName == "change")
+        {
+          mode = CHANGE;
+        }
+      else if (modeName != "all")
+        {
+          NS_FATAL_ERROR ("Unknown trace mode " << modeName);
+        }
+      if (mode == BUCKET && !bucket.IsStrictlyPositive ())
+        {
+          NS_FATAL_ERROR ("Trace bucket must be positive");
+        }
+    }
+
+    bool binary;    // Binary (else text) format.
+    Mode mode;      // Reduction of samples.
+    Time bucket;    // Bucket width (BUCKET).
+    double epsilon; // Min relative change written (CHANGE).
+  };
+
+  // With keyed, the first column is the key of the sample.
+  TraceSink (const std::string &fileName, const std::string &columns,
+             const Options &options, size_t bufferSize = BUFFER_SIZE,
+             bool keyed = false)
+    : m_columns (columns),
+      m_output (columns),
+      m_options (options),
+      m_used (0),
+      m_keyed (keyed),
+      m_bucket (0)
+  {
+    if (columns.empty () || columns.size () > 63
+        || columns.find_first_not_of ("ud") != std::string::npos)
+      {
+        NS_FATAL_ERROR ("Bad trace columns \"" << columns << "\"");
+      }
+    if (m_options.mode == BUCKET)
+      {
+        m_output += columns + columns + std::string (columns.size (), 'd');
+      }
+    m_recordMax = COLUMN_MAX * (m_output.size () + 1) + 1;
+    m_buffer.resize (std::max (bufferSize, m_recordMax));
+
+    m_file = std::fopen (fileName.c_str (), options.binary ? "wb" : "w");
+    if (m_file == 0)
+      {
+        NS_FATAL_ERROR ("Cannot open trace file " << fileName);
+      }
+    if (m_options.binary)
+      {
+        char header[8] = { 'N', 'S', '3', 'T', 2, (char) m_output.size (), 0, 0 };
+        Append (header, sizeof (header));
+        std::string kinds = m_output;
+        kinds.resize ((kinds.size () + 7) / 8 * 8, '\0');
+        Append (kinds.data (), kinds.size ());
+      }
+  }
+
+  ~TraceSink ()
+  {
+    WritePending ();
+    Flush ();
+    std::fclose (m_file);
+  }
+
+  // Write one-column sample at current simulation time.
+  void Write (double value)
+  {
+    WriteRow (Simulator::Now (), &value);
+  }
+
+  // Write one-column sample at given time.
+  void Write (Time time, double value)
+  {
+    WriteRow (time, &value);
+  }
+
+  // Write sample at given time, one value per column.
+  void WriteRow (Time time, const double *values)
+  {
+    size_t n = m_columns.size ();
+    if (m_options.mode == ALL)
+      {
+        Emit (time, values, n);
+        return;
+      }
+    if (m_options.mode == BUCKET)
+      {
+        int64_t bucket = time.GetNanoSeconds () / m_options.bucket.GetNanoSeconds ();
+        if (bucket != m_bucket)
+          {
+            WritePending ();
+            m_bucket = bucket;
+          }
+      }
+
+    State &state = m_states[m_keyed ? (int64_t) values[0] : 0];
+    switch (m_options.mode)
+      {
+      case BUCKET:
+        if (!state.pending)
+          {
+            state.count = 0;
+            state.min.assign (values, values + n);
+            state.max.assign (values, values + n);
+            state.sum.assign (n, 0.0);
+          }
+        for (size_t i = 0; i < n; i++)
+          {
+            state.min[i] = std::min (state.min[i], values[i]);
+            state.max[i] = std::max (state.max[i], values[i]);
+            state.sum[i] += values[i];
+          }
+        state.count++;
+        Hold (state, time, values);
+        break;
+
+      case CHANGE:
+        if (!state.written.empty () && !Changed (state, values))
+          {
+            Hold (state, time, values);
+            break;
+          }
+        if (state.pending)
+          {
+            // Keep a step a step: write the flat part up to its end.
+            state.pending = false;
+            Emit (state.time, &state.values[0], n);
+          }
+        state.written.assign (values, values + n);
+        Emit (time, values, n);
+        break;
+
+      default:
+        break;
+      }
+  }
+
+  // Write out buffered samples.
+  void Flush (void)
+  {
+    if (m_used > 0)
+      {
+        std::fwrite (&m_buffer[0], 1, m_used, m_file);
+        m_used = 0;
+      }
+  }
+
+  // Number of values per sample.
+  size_t GetColumns (void) const
+  {
+    return m_columns.size ();
+  }
+
+private:
+  // Reduction state of the samples of one key.
+  struct State
+  {
+    State ()
+      : pending (false),
+        count (0)
+    {
+    }
+
+    Time time;                   // Time of held sample.
+    std::vector<double> values;  // Held sample.
+    bool pending;                // Held sample not yet written.
+    std::vector<double> written; // Last written sample (CHANGE).
+    uint32_t count;              // Samples in current bucket (BUCKET).
+    std::vector<double> min;     // Min of each column in bucket.
+    std::vector<double> max;     // Max of each column in bucket.
+    std::vector<double> sum;     // Sum of each column in bucket.
+  };
+
+  static bool EarlierHeld (const State *a, const State *b)
+  {
+    return a->time < b->time;
+  }
+
+  // Keep sample until its bucket ends (or it turns out to be the last).
+  void Hold (State &state, Time time, const double *values)
+  {
+    state.time = time;
+    state.values.assign (values, values + m_columns.size ());
+    state.pending = true;
+  }
+
+  // Write the held samples (or buckets) of all keys.
+  void WritePending (void)
+  {
+    std::vector<State *> held;
+    for (std::map<int64_t, State>::iterator it = m_states.begin (); it != m_states.end (); ++it)
+      {
+        if (it->second.pending)
+          {
+            held.push_back (&it->second);
+          }
+      }
+    std::stable_sort (held.begin (), held.end (), &TraceSink::EarlierHeld);
+
+    size_t n = m_columns.size ();
+    for (size_t k = 0; k < held.size (); k++)
+      {
+        State &state = *held[k];
+        state.pending = false;
+        if (m_options.mode != BUCKET)
+          {
+            state.written = state.values;
+            Emit (state.time, &state.values[0], n);
+            continue;
+          }
+        std::vector<double> row (state.values);
+        row.insert (row.end (), state.min.begin (), state.min.end ());
+        row.insert (row.end (), state.max.begin (), state.max.end ());
+        for (size_t i = 0; i < n; i++)
+          {
+            row.push_back (state.sum[i] / state.count);
+          }
+        Emit (state.time, &row[0], row.size ());
+      }
+  }
+
+  // True if a value differs from the last written one of the key by more
+  // than epsilon.
+  bool Changed (const State &state, const double *values) const
+  {
+    for (size_t i = 0; i < state.written.size (); i++)
+      {
+        if (std::fabs (values[i] - state.written[i]) > m_options.epsilon * std::fabs (state.written[i]))
+          {
+            return true;
+          }
+      }
+    return false;
+  }
+
+  void Emit (Time time, const double *values, size_t n)
+  {
+    if (m_used + m_recordMax > m_buffer.size ())
+      {
+        Flush ();
+      }
+    if (m_options.binary)
+      {
+        int64_t ns = time.GetNanoSeconds ();
+        Append (&ns, sizeof (ns));
+        Append (values, n * sizeof (double));
+        return;
+      }
+    m_used += std::snprintf (&m_buffer[m_used], COLUMN_MAX, "%g",
+                             time.GetSeconds ());
+    for (size_t i = 0; i < n; i++)
+      {
+        if (m_output[i] == 'u')
+          {
+            m_used += std::snprintf (&m_buffer[m_used], COLUMN_MAX, " %u",
+                                     (uint32_t) values[i]);
+          }
+        else
+          {
+            m_used += std::snprintf (&m_buffer[m_used], COLUMN_MAX, " %g",
+                                     values[i]);
+          }
+      }
+    m_buffer[m_used++] = '\n';
+  }
+
+  void Append (const void *data, size_t size)
+  {
+    std::memcpy (&m_buffer[m_used], data, size);
+    m_used += size;
+  }
+
+  std::FILE *m_file;             // Trace file.
+  std::string m_columns;         // Kind of each column.
+  std::string m_output;          // Kind of each written column.
+  Options m_options;             // Format and reduction.
+  size_t m_recordMax;            // Max bytes of one sample.
+  std::vector<char> m_buffer;    // Samples not yet written.
+  size_t m_used;                 // Bytes used in buffer.
+
+  bool m_keyed;                  // First column is the key.
+  std::map<int64_t, State> m_states; // Reduction state of each key.
+  int64_t m_bucket;              // Index of current bucket (BUCKET).
+};
+
+} // namespace ns3
+
+#endif /* TRACE_SINK_H */
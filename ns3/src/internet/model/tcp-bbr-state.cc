@@ -76,7 +76,7 @@ void BbrStateMachine::update() {
   NS_LOG_FUNCTION(this);
 
   if (m_state == NULL) {
-    NS_LOG_INFO(this << " m_state NULL. Probably flow terminated, so ok.");
+    NS_LOG_INFO(this << " m_state NULL. Not started yet, so ok.");
     return;
   }
 
@@ -94,14 +94,6 @@ void BbrStateMachine::update() {
 
   // Cull BW window (except in DRAIN state).
   m_owner -> cullBWwindow();
-
-  // Schedule next event (if we can).
-  Time rtt = m_owner -> getRTT();
-  if (!rtt.IsNegative()) {
-    Simulator::Schedule(rtt, &BbrStateMachine::update, this);
-    NS_LOG_LOGIC(this << "  Next event: " << rtt.GetSeconds());
-  } else // update() will be called in PktsAcked() upon getting first rtt.
-    NS_LOG_LOGIC(this << "  Not scheduling next event.");
 }
 
 // Change current state to new state.
@@ -201,8 +193,8 @@ void BbrStartupState::enter() {
   NS_LOG_INFO(this << " State: " << GetName());
 
   // Set gains to 2/ln(2).
-  m_owner -> m_pacing_gain = bbr::STARTUP_GAIN;
-  m_owner -> m_cwnd_gain = bbr::STARTUP_GAIN;
+  m_owner -> m_pacing_gain = m_owner -> m_startup_gain;
+  m_owner -> m_cwnd_gain = m_owner -> m_startup_gain;
 }
 
 // Invoked when state updated.
@@ -281,13 +273,13 @@ void BbrDrainState::enter() {
   NS_LOG_INFO(this << " State: " << GetName());
 
   // Set pacing gain to 1/[2/ln(2)].
-  m_owner -> m_pacing_gain = 1 / bbr::STARTUP_GAIN;
+  m_owner -> m_pacing_gain = 1 / m_owner -> m_startup_gain;
 
   // Maintain high cwnd gain.
-  if (PACING_CONFIG == NO_PACING)
-    m_owner -> m_cwnd_gain = 1 / bbr::STARTUP_GAIN; // Slow cwnd if no pacing.
+  if (m_owner -> m_pacing_mode == NO_PACING)
+    m_owner -> m_cwnd_gain = 1 / m_owner -> m_startup_gain; // Slow cwnd if no pacing.
   else
-    m_owner -> m_cwnd_gain = bbr::STARTUP_GAIN; // Maintain high cwnd gain.
+    m_owner -> m_cwnd_gain = m_owner -> m_startup_gain; // Maintain high cwnd gain.
 
   // Get BDP for target inflight limit when will exit STARTUUP..
   double bdp = m_owner -> getBDP();
@@ -365,7 +357,7 @@ void BbrProbeBWState::enter() {
   m_owner -> m_pacing_gain = bbr::STEADY_FACTOR;
   if (m_gain_cycle == 0) // Phase 0 is "high" cycle.
     m_owner -> m_pacing_gain += bbr::PROBE_FACTOR;
-  if (PACING_CONFIG == NO_PACING)
+  if (m_owner -> m_pacing_mode == NO_PACING)
     m_owner -> m_cwnd_gain = m_owner -> m_pacing_gain;
   else
     m_owner -> m_cwnd_gain = bbr::STEADY_FACTOR * 2;
@@ -380,14 +372,14 @@ void BbrProbeBWState::execute() {
   if (m_gain_cycle == 0)
     m_owner -> m_pacing_gain = bbr::STEADY_FACTOR + bbr::PROBE_FACTOR;
   else if (m_gain_cycle == 1)
-    if (PACING_CONFIG == NO_PACING) 
+    if (m_owner -> m_pacing_mode == NO_PACING) 
       m_owner -> m_pacing_gain = bbr::STEADY_FACTOR - bbr::DRAIN_FACTOR/8;
     else
       m_owner -> m_pacing_gain = bbr::STEADY_FACTOR - bbr::DRAIN_FACTOR;
   else
     m_owner -> m_pacing_gain = bbr::STEADY_FACTOR;
 
-  if (PACING_CONFIG == NO_PACING)
+  if (m_owner -> m_pacing_mode == NO_PACING)
     // If configed for NO_PACING, rate is controlled by cwnd at bdp.
     m_owner -> m_cwnd_gain = m_owner -> m_pacing_gain;
   else
@@ -442,12 +434,12 @@ void BbrProbeRTTState::enter() {
   m_owner -> m_pacing_gain = bbr::STEADY_FACTOR;
   m_owner -> m_cwnd_gain = bbr::STEADY_FACTOR;
 
-  // Compute time when to exit: max (0.2 seconds, min RTT).
+  // Compute time when to exit: max (ProbeRttMinTime, min RTT).
   Time rtt = m_owner -> getRTT();
-  if (rtt.GetSeconds() > 0.2)
+  if (rtt > m_owner -> m_probe_rtt_min_time)
     m_probe_rtt_time = rtt;
   else
-    m_probe_rtt_time = Time(0.2 * 1000000000);
+    m_probe_rtt_time = m_owner -> m_probe_rtt_min_time;
   m_probe_rtt_time = m_probe_rtt_time + Simulator::Now();
     
   NS_LOG_LOGIC(this << " " <<
@@ -460,7 +452,7 @@ void BbrProbeRTTState::execute() {
   NS_LOG_LOGIC(this << " State: " << GetName());
 
   // Cwnd target is minimum.
-  m_owner -> m_cwnd = bbr::MIN_CWND * 1500; // In bytes.
+  m_owner -> m_cwnd = m_owner -> m_min_cwnd * 1500; // In bytes.
 
   // If enough time elapsed, PROBE_RTT --> PROBE_BW.
   Time now = Simulator::Now();
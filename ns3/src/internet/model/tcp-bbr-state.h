@@ -50,6 +50,7 @@ class BbrStateMachine : public Object {
   bbr::bbr_state getStateType() const;
 
   // Update by executing current state.
+  // Called by owner at the end of each packet-timed round.
   void update();
 
  private:
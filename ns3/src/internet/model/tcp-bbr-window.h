@@ -0,0 +1,168 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 WPI, Verizon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCP_BBR_WINDOW_H
+#define TCP_BBR_WINDOW_H
+
+#include <cmath>
+#include <vector>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+namespace bbr {
+
+// Ring buffer used as a double-ended queue by the BBR' windows.
+// Storage only grows (doubling), so once a window reaches its
+// working size, insert and remove no longer allocate.
+template <typename T>
+class RingBuffer {
+
+public:
+
+  RingBuffer() : m_head(0), m_size(0) {}
+
+  bool empty() const { return m_size == 0; }
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_buf.size(); }
+
+  // Element i, counting from the front (oldest).
+  T &operator[](size_t i) { return m_buf[(m_head + i) & (m_buf.size() - 1)]; }
+  const T &operator[](size_t i) const {
+    return m_buf[(m_head + i) & (m_buf.size() - 1)];
+  }
+
+  T &front() { return (*this)[0]; }
+  const T &front() const { return (*this)[0]; }
+  T &back() { return (*this)[m_size - 1]; }
+  const T &back() const { return (*this)[m_size - 1]; }
+
+  void push_back(const T &value) {
+    if (m_size == m_buf.size())
+      grow();
+    m_size++;
+    back() = value;
+  }
+
+  void pop_back() { m_size--; }
+
+  // Remove the n oldest elements.
+  void pop_front(size_t n = 1) {
+    m_head = (m_head + n) & (m_buf.size() - 1);
+    m_size -= n;
+  }
+
+  void clear() { m_head = 0; m_size = 0; }
+
+private:
+
+  // Double capacity (always a power of 2, so index wraps with a mask).
+  void grow() {
+    std::vector<T> buf(m_buf.empty() ? 8 : 2 * m_buf.size());
+    for (size_t i = 0; i < m_size; i++)
+      buf[i] = (*this)[i];
+    m_buf.swap(buf);
+    m_head = 0;
+  }
+
+  std::vector<T> m_buf;   // Storage.
+  size_t m_head;          // Index of front element.
+  size_t m_size;          // Number of elements.
+};
+
+// Windowed min/max filter over samples stamped with wall-clock time
+// and packet-timed round.
+//
+// Like the minmax filter Linux BBR uses (K. Nichols), samples that can
+// no longer be the best in the window are dropped, but here all other
+// samples are kept (a monotonic queue) so the result is exact: the best
+// of all samples in the window, same as a scan over every sample.
+// Kept samples are ordered oldest (front) to newest (back), and each is
+// better than all newer ones, so the best one is always at the front.
+// Insert, expire and query are amortized O(1).
+//
+// Compare(a, b) is true if a is better than b, e.g., std::greater for
+// a max filter and std::less for a min filter.
+template <typename T, typename Compare>
+class WindowedFilter {
+
+public:
+
+  // A stored sample.
+  struct sample {
+    T value;                 // Sample value.
+    Time time;               // Time stored.
+    int round;               // Virtual time stored.
+  };
+
+  // Add sample, dropping older samples that are not better.
+  // Time and round must not decrease between calls.
+  void update(const T &value, Time time, int round) {
+    if (isNan(value))
+      return;
+    while (!m_samples.empty() && !m_better(m_samples.back().value, value))
+      m_samples.pop_back();
+    sample s;
+    s.value = value;
+    s.time = time;
+    s.round = round;
+    m_samples.push_back(s);
+  }
+
+  // Remove samples stored before time.
+  void expireTime(Time time) {
+    while (!m_samples.empty() && m_samples.front().time < time)
+      m_samples.pop_front();
+  }
+
+  // Remove samples stored before round.
+  void expireRound(int round) {
+    while (!m_samples.empty() && m_samples.front().round < round)
+      m_samples.pop_front();
+  }
+
+  // Best value in window (only valid if not empty).
+  const T &getBest() const { return m_samples.front().value; }
+
+  bool empty() const { return m_samples.empty(); }
+  void clear() { m_samples.clear(); }
+
+  // Number of samples kept and storage allocated for them.
+  size_t size() const { return m_samples.size(); }
+  size_t capacity() const { return m_samples.capacity(); }
+
+  // Oldest and newest samples kept.
+  const sample &oldest() const { return m_samples.front(); }
+  const sample &newest() const { return m_samples.back(); }
+
+private:
+
+  // NaN samples (e.g., 0/0 BW) never win a comparison, so ignore them.
+  static bool isNan(double value) { return std::isnan(value); }
+  static bool isNan(const Time &) { return false; }
+
+  RingBuffer<sample> m_samples;  // Candidate samples, best at front.
+  Compare m_better;              // True if first argument is better.
+};
+
+} // end of namespace bbr
+
+} // end of namespace ns3
+
+#endif // TCP_BBR_WINDOW_H
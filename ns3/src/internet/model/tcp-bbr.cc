@@ -23,6 +23,10 @@
 // NS includes.
 #include "ns3/log.h"
 #include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/enum.h"
 #include "tcp-socket-base.h"          // For pacing configuration options.
 
 // BBR' includes.
@@ -40,53 +44,64 @@ TcpBbr::TcpBbr(void) :
   TcpCongestionOps(),
   m_pacing_gain(0.0),
   m_cwnd_gain(0.0),
+  m_pacing_mode(TCP_PACING),
+  m_startup_gain(bbr::STARTUP_GAIN),
+  m_pacing_factor(bbr::PACING_FACTOR),
+  m_bw_window_time(bbr::BW_WINDOW_TIME),
+  m_rtt_window_time(Seconds(bbr::RTT_WINDOW_TIME)),
+  m_probe_rtt_min_time(Seconds(bbr::PROBE_RTT_MIN_TIME)),
+  m_min_cwnd(bbr::MIN_CWND),
+  m_time_config(bbr::PACKET_TIME),
   m_round(0),
-  m_delivered(0),
   m_next_round_delivered(0),
+  m_rtt_window_size(0),
+  m_rtt_window_bytes(0),
   m_bytes_in_flight(0),
   m_min_rtt_change(Time(0)),
   m_cwnd(0.0),
   m_prior_cwnd(0.0), 
   m_packet_conservation(Time(0)),
-  m_in_retrans_seq(false),
-  m_retrans_seq(0),
   m_machine(this),
   m_state_startup(this),
   m_state_drain(this),
   m_state_probe_bw(this),
   m_state_probe_rtt(this) {
 
+  NS_LOG_FUNCTION(this);
+}
+
+// Once attributes set: log configuration, enter STARTUP.
+void TcpBbr::NotifyConstructionCompleted() {
+
   NS_LOG_FUNCTION(this);
   NS_LOG_INFO(this << "  BBR' version: v" << bbr::VERSION);
 
   // Constants in "tcp-bbr.h"
   NS_LOG_INFO(this << "  INIT_RTT: " << bbr::INIT_RTT.GetSeconds() << " sec");
   NS_LOG_INFO(this << "  INIT_BW: " << bbr::INIT_BW << " Mb/s");
-  NS_LOG_INFO(this << "  BW_WINDOW_TIME: " << bbr::BW_WINDOW_TIME << " rtts");
-  NS_LOG_INFO(this << "  MIN_CWND: " << bbr::MIN_CWND << " bytes");
   NS_LOG_INFO(this << "  STARTUP_THRESHOLD: " << bbr::STARTUP_THRESHOLD);
-  NS_LOG_INFO(this << "  STARTUP_GAIN: " << bbr::STARTUP_GAIN);
   NS_LOG_INFO(this << "  STEADY_FACTOR: " << bbr::STEADY_FACTOR);
   NS_LOG_INFO(this << "  PROBE_FACTOR: " << bbr::PROBE_FACTOR);
   NS_LOG_INFO(this << "  DRAIN_FACTOR: " << bbr::DRAIN_FACTOR);
-  NS_LOG_INFO(this << "  PACING_FACTOR: " << bbr::PACING_FACTOR);
-
-  // Timing config (used for culling BW window) in "tcp-bbr.h"
-  if (bbr::TIME_CONFIG == bbr::WALLCLOCK_TIME) 
-    NS_LOG_INFO("TIME_CONFIG: WALLCLOCK_TIME - BW window culling with wallclock time.");
-  else if (bbr::TIME_CONFIG == bbr::PACKET_TIME) 
-    NS_LOG_INFO("TIME_CONFIG: PACKET_TIME - BW window culling with packet time.");
-  else  {
-    NS_LOG_INFO("WARNING! Unknown TIME_CONFIG: " << bbr::TIME_CONFIG);
-    NS_LOG_INFO("BW window culling with packet time.");
-  }
 
-  // Constant in "tcp-socket-base.h"
-  if (PACING_CONFIG == NO_PACING) 
-    NS_LOG_INFO(this << "  Note: BBR' configured with pacing NO_PACING.");
+  // Attributes (defaults in "tcp-bbr.h")
+  NS_LOG_INFO(this << "  BwWindowTime: " << m_bw_window_time << " rtts");
+  NS_LOG_INFO(this << "  RttWindowTime: " << m_rtt_window_time.GetSeconds() << " sec");
+  NS_LOG_INFO(this << "  ProbeRttMinTime: " << m_probe_rtt_min_time.GetSeconds() << " sec");
+  NS_LOG_INFO(this << "  MinCwnd: " << m_min_cwnd << " bytes");
+  NS_LOG_INFO(this << "  StartupGain: " << m_startup_gain);
+  NS_LOG_INFO(this << "  PacingFactor: " << m_pacing_factor);
+
+  // Timing config (used for culling BW window).
+  if (m_time_config == bbr::WALLCLOCK_TIME) 
+    NS_LOG_INFO("TimeConfig: WALLCLOCK_TIME - BW window culling with wallclock time.");
+  else
+    NS_LOG_INFO("TimeConfig: PACKET_TIME - BW window culling with packet time.");
 
   // First state is STARTUP.
   m_machine.changeState(&m_state_startup);
+
+  TcpCongestionOps::NotifyConstructionCompleted();
 }
 
 // Copy constructor.
@@ -94,22 +109,32 @@ TcpBbr::TcpBbr(const TcpBbr &sock) :
   TcpCongestionOps(sock),
   m_pacing_gain(0.0),
   m_cwnd_gain(0.0),
+  m_pacing_mode(sock.m_pacing_mode),
+  m_startup_gain(sock.m_startup_gain),
+  m_pacing_factor(sock.m_pacing_factor),
+  m_bw_window_time(sock.m_bw_window_time),
+  m_rtt_window_time(sock.m_rtt_window_time),
+  m_probe_rtt_min_time(sock.m_probe_rtt_min_time),
+  m_min_cwnd(sock.m_min_cwnd),
+  m_time_config(sock.m_time_config),
   m_round(0),
-  m_delivered(0),
   m_next_round_delivered(0),
+  m_rtt_window_size(0),
+  m_rtt_window_bytes(0),
   m_bytes_in_flight(0),
   m_min_rtt_change(Time(0)),
   m_cwnd(0.0),
   m_prior_cwnd(0.0), 
   m_packet_conservation(Time(0)),
-  m_in_retrans_seq(false),
-  m_retrans_seq(0),
   m_machine(this),
   m_state_startup(this),
   m_state_drain(this),
   m_state_probe_bw(this),
   m_state_probe_rtt(this) {  
   NS_LOG_FUNCTION("[copy constructor]" << this << &sock);
+
+  // Copy starts afresh in STARTUP, too (it has no estimates).
+  m_machine.changeState(&m_state_startup);
 }
 
 // Default destructor.
@@ -122,7 +147,51 @@ TypeId TcpBbr::GetTypeId(void) {
   static TypeId tid = TypeId("ns3::TcpBbr")
     .SetParent<TcpCongestionOps>()
     .SetGroupName("Internet")
-    .AddConstructor<TcpBbr>();
+    .AddConstructor<TcpBbr>()
+    .AddAttribute("StartupGain",
+                  "Pacing and cwnd gain in STARTUP",
+                  DoubleValue(bbr::STARTUP_GAIN),
+                  MakeDoubleAccessor(&TcpBbr::m_startup_gain),
+                  MakeDoubleChecker<double>(1.0))
+    .AddAttribute("PacingFactor",
+                  "Factor of BW to pace at when pacing gain is 1",
+                  DoubleValue(bbr::PACING_FACTOR),
+                  MakeDoubleAccessor(&TcpBbr::m_pacing_factor),
+                  MakeDoubleChecker<double>(0.0))
+    .AddAttribute("BwWindowTime",
+                  "Length of BW window for max filter (in RTTs)",
+                  UintegerValue(bbr::BW_WINDOW_TIME),
+                  MakeUintegerAccessor(&TcpBbr::m_bw_window_time),
+                  MakeUintegerChecker<uint32_t>(1))
+    .AddAttribute("RttWindowTime",
+                  "Length of RTT window for min filter",
+                  TimeValue(Seconds(bbr::RTT_WINDOW_TIME)),
+                  MakeTimeAccessor(&TcpBbr::m_rtt_window_time),
+                  MakeTimeChecker())
+    .AddAttribute("ProbeRttMinTime",
+                  "Minimum time to stay in PROBE_RTT (or min RTT, if larger)",
+                  TimeValue(Seconds(bbr::PROBE_RTT_MIN_TIME)),
+                  MakeTimeAccessor(&TcpBbr::m_probe_rtt_min_time),
+                  MakeTimeChecker())
+    .AddAttribute("MinCwnd",
+                  "Minimum target cwnd (in bytes)",
+                  UintegerValue(bbr::MIN_CWND),
+                  MakeUintegerAccessor(&TcpBbr::m_min_cwnd),
+                  MakeUintegerChecker<uint32_t>())
+    .AddAttribute("TimeConfig",
+                  "Time used for culling BW window: packet (rounds) or wallclock",
+                  EnumValue(bbr::PACKET_TIME),
+                  MakeEnumAccessor(&TcpBbr::m_time_config),
+                  MakeEnumChecker(bbr::PACKET_TIME, "PacketTime",
+                                  bbr::WALLCLOCK_TIME, "WallclockTime"))
+    .AddTraceSource("RttWindowSize",
+                    "Number of RTT samples kept for computing min RTT",
+                    MakeTraceSourceAccessor(&TcpBbr::m_rtt_window_size),
+                    "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource("RttWindowBytes",
+                    "Bytes allocated for RTT samples",
+                    MakeTraceSourceAccessor(&TcpBbr::m_rtt_window_bytes),
+                    "ns3::TracedValueCallback::Uint32");
   return tid;
 }
 
@@ -158,18 +227,18 @@ uint32_t TcpBbr::GetSsThresh(Ptr<const TcpSocketState> tcb,
 // On receiving ack:
 // - update congestion window
 // - store RTT
-// - compute and store estimated BW
-// - compute and set pacing rate
 // tcb = transmission control block
 void TcpBbr::PktsAcked(Ptr<TcpSocketState> tcb, uint32_t packets_acked,
                        const Time &rtt) {
 
   NS_LOG_FUNCTION(this << packets_acked << rtt);
 
+  updatePacingMode(tcb);
+
   ////////////////////////////////////////////
   // UPDATE TCP CONGESTION WINDOW (CWND)
 
-  uint32_t bytes_delivered = packets_acked * 1500;
+  uint32_t bytes_delivered = packets_acked * tcb->m_segmentSize;
 
   // If in Fast Recovery, target cwnd was set in CongestionStateSet().
   if (tcb->m_congState == TcpSocketState::CA_RECOVERY) {
@@ -206,136 +275,122 @@ void TcpBbr::PktsAcked(Ptr<TcpSocketState> tcb, uint32_t packets_acked,
   // See if changed minimum RTT (to decide when to PROBE_RTT).
   Time now = Simulator::Now();
   Time min_rtt = getRTT();
-  if (rtt < getRTT()) {
+  if (rtt < min_rtt) {
     NS_LOG_LOGIC(this << "  New min RTT: " << 
                 rtt << " sec (was: " << min_rtt.GetSeconds() << ")");
     m_min_rtt_change = now;  
   }
 
   // Add to RTT window.
-  m_rtt_window[now] = rtt;
+  m_rtt_window.update(rtt, now, m_round);
+  traceRTTwindow();
 
-  // Upon first RTT, call update() to initialize timer.
-  if (m_rtt_window.size() == 1) {
-    NS_LOG_LOGIC(this << "  First rtt, calling update() to init.");
-    m_machine.update();
-  }
+  NS_LOG_INFO(this << "  DATA rtt: " << rtt.GetSeconds() << "  " <<
+              "m_cwnd: " << m_cwnd << " bytes  " <<
+              "tcb->m_cWnd: " << tcb->m_cWnd);
+}
+
+// On delivery rate sample (once per ack):
+// - update packet-timed round
+// - store estimated BW
+// - update state machine (once per round)
+// - compute and set pacing rate
+// tcb = transmission control block
+// rc = connection delivery state
+// rs = rate sample
+void TcpBbr::CongControl(Ptr<TcpSocketState> tcb,
+                         const TcpRateOps::TcpRateConnection &rc,
+                         const TcpRateOps::TcpRateSample &rs) {
+
+  NS_LOG_FUNCTION(this << rs.m_delivered << rs.m_interval);
+
+  updatePacingMode(tcb);
 
   ////////////////////////////////////////////
   // BW ESTIMATION
   // Based on [CCYJ17b]:
   // Cheng et al., "Delivery Rate Estimation", IETF Draft, Jul 3, 2017
   //
-  //                                (outstanding)
-  // TCP Window: (latest ACKed) W_a [W_1 ... W_n] W_s (next sent)
-  //
-  // Send() 
-  //   Record W_a
-  //   Record time W_t
-  //   Send W_s
-  // PktsAcked()
-  //   Record time W_t'
-  //   Compute BW: bw = (W_s - W_a) / (W_t' - W_t)
-  //   Update data structures
-
-  SequenceNumber32 ack = tcb->m_lastAckedSeq;  // W_s
-  now = Simulator::Now();                      // W_t'
-  bbr::packet_struct packet;
-
-  // Update packet-timed RTT.
-  m_delivered += tcb->m_segmentSize;
-  packet.delivered = -1;
-  for (auto it = m_pkt_window.begin(); it != m_pkt_window.end(); it++) {
-    if (it->sent == ack)
-      packet = *it;
-  }
-  if (packet.delivered >= m_next_round_delivered) {
-    m_next_round_delivered = m_delivered;
-    m_round++;
-    NS_LOG_LOGIC(this << " New packet-timed RTT.  Round: " << m_round);
-  }
-
-  // See if retransmission sequence should end.
-  bool do_est_bw = true;
-  if (m_in_retrans_seq) {
-    NS_LOG_LOGIC(this << "  In retransmission sequence: " << m_retrans_seq);
-    if (ack != m_retrans_seq) {
-      m_in_retrans_seq = false;
-      NS_LOG_LOGIC(this << "  Retransmission sequence ended: " << ack);
+  // Socket stamps each segment with delivered bytes when sent and
+  // samples delivery rate from the latest segment ACKed or SACKed
+  // (see tcp-rate-ops.h).  Retransmitted segments are sampled too.
+
+  // Only a valid sample (e.g., something newly delivered) ends a round
+  // or estimates BW.
+  double bw_est = -1.0;
+  bool new_round = false;
+  if (rs.m_delivered >= 0 && rs.m_interval.IsStrictlyPositive()) {
+
+    // Update packet-timed RTT: a round ends when a packet sent after
+    // the previous round ended is delivered.
+    if (rs.m_priorDelivered >= m_next_round_delivered) {
+      m_next_round_delivered = rc.m_delivered;
+      m_round++;
+      new_round = true;
+      NS_LOG_LOGIC(this << " New packet-timed RTT.  Round: " << m_round);
     }
-    // Don't estimate BW if in retrans sequence (or just ending_.
-    do_est_bw = false; 
-  }
 
-  // If ack not in list (or list empty), unknown when sent so ignore.
-  // This happens most often during retransmission sequences.
-  if (m_pkt_window.size() == 0) {
-    NS_LOG_LOGIC(this << " Packet window size is zero.");
-    return; // Nothing more to do.
-  }
-  auto first = m_pkt_window.begin()->sent;
-  if (ack < first) {
-    NS_LOG_LOGIC(this << " Not found.  Ack: "<< ack <<
-                "  Earliest in list: "<< first);
-    return;  // Nothing more to do.
-  }
+    // Convert to Mb/s.
+    bw_est = rs.m_deliveryRate.GetBitRate() / 1000000.0;
 
-  // Find oldest ack in window, <= current.
-  packet.sent = 0;
-  packet.time = Time(0);
-  for (auto it = m_pkt_window.begin(); it != m_pkt_window.end(); it++)
-    if (it->sent <= ack && it->sent > packet.sent)
-      packet = *it;  // W_a
-
-  // Remove all entries with acks <= current from window.
-  for (unsigned int i=0; i < m_pkt_window.size(); )
-    if (m_pkt_window[i].sent <= packet.sent) 
-      m_pkt_window.erase(m_pkt_window.begin() + i);
-    else
-      i++;
-
-  // Estimate BW.
-  double bw_est = 0.0;
-  if (do_est_bw) {
-
-    // Estimate BW: bw = (W_s - W_a) / (W_t' - W_t)
-    bw_est = (ack - packet.acked) /
-             (now.GetSeconds() - packet.time.GetSeconds());
-    bw_est *= 8;          // Convert to b/s.
-    bw_est /= 1000000;    // Convert to Mb/s.
-
-    // Add to BW window.
-    bbr::bw_struct bw;
-    bw.bw_est = bw_est;
-    bw.time = now;
-    bw.round = m_round;
-    m_bw_window.push_back(bw);
-  }
+    // Application-limited samples underestimate BW, so only store
+    // them if they would raise the max.
+    if (!rs.m_isAppLimited || bw_est >= getBW())
+      m_bw_window.update(bw_est, Simulator::Now(), m_round);
+  } else
+    NS_LOG_LOGIC(this << "  No valid rate sample.");
+
+  ////////////////////////////////////////////
+  // UPDATE STATE MACHINE.
+  // Once per packet-timed round (so, no timers needed).
+  if (new_round)
+    m_machine.update();
 
   ////////////////////////////////////////////
   // COMPUTE AND SET PACING RATE.
+  updatePacingRate(tcb);
+
+  ////////////////////////////////////////////
+  // Report data.
+  NS_LOG_LOGIC(this << 
+              " m_round: " << m_round <<
+              "  delivered: " << rs.m_delivered <<
+              "  interval: " << rs.m_interval.GetSeconds() <<
+              "  app-limited: " << rs.m_isAppLimited);
+  NS_LOG_INFO(this << "  DATA pacing-gain " << m_pacing_gain <<  "  " <<
+              "pacing-rate " << tcb->GetPacingRate() << " Mb/s  " <<
+              "bw: " << bw_est << " Mb/s");
+}
+
+// Compute and set pacing rate based on BW and gain.
+// tcb = transmission control block
+void TcpBbr::updatePacingRate(Ptr<TcpSocketState> tcb) {
+
+  NS_LOG_FUNCTION(this);
+
   // Set pacing rate (in Mb/s), adjusted by gain.
   double pacing_rate = getBW() * m_pacing_gain;
 
   // There may be some advantages to pacing at just under BW.
   // Either way, this is adjustable in header file.
   if (m_pacing_gain == 1)
-    pacing_rate *= bbr::PACING_FACTOR;
+    pacing_rate *= m_pacing_factor;
   
   if (pacing_rate < 0)
     pacing_rate = 0.0;
 
-  if (PACING_CONFIG != NO_PACING) {
+  if (m_pacing_mode != NO_PACING) {
 
     // If in PROBE_RTT, minimize pacing rate since TCP pacing
     // might have built-up queue.
     if (m_machine.getStateType() == bbr::PROBE_RTT_STATE) {
-      double probe_rtt_pacing_rate = bbr::MIN_CWND;   // Bytes (B).
+      Time min_rtt = getRTT();
+      double probe_rtt_pacing_rate = m_min_cwnd;      // Bytes (B).
       probe_rtt_pacing_rate /=  min_rtt.GetSeconds(); // B/s.
       probe_rtt_pacing_rate *= 8;                     // Convert to b/s.
       probe_rtt_pacing_rate /= 1000000;               // Convert to Mb/s.
       NS_LOG_LOGIC(this << " In PROBE_RTT," <<
-                   "  bbr::MIN_CWND: " << bbr::MIN_CWND <<
+                   "  m_min_cwnd: " << m_min_cwnd <<
                    "  min_rtt: " << min_rtt.GetSeconds() << 
                    "  pacing rate: " << pacing_rate << 
                    "  probe_rtt pacing rate: " << probe_rtt_pacing_rate);
@@ -346,28 +401,10 @@ void TcpBbr::PktsAcked(Ptr<TcpSocketState> tcb, uint32_t packets_acked,
     // Set rate.
     tcb -> SetPacingRate(pacing_rate);
   }
-
-  ////////////////////////////////////////////
-  // Report data.
-  NS_LOG_LOGIC(this << 
-              " m_round: " << m_round <<
-              "  W_s: " << ack <<
-              "  W_a: " << packet.acked <<
-              "  W_t': " << now.GetSeconds() <<
-              "  W_t: " << packet.time.GetSeconds());
-  NS_LOG_LOGIC(this << "  byte-diff: " << (ack - packet.acked));
-  NS_LOG_LOGIC(this << "  time-diff: " <<
-              (now.GetSeconds() - packet.time.GetSeconds()));
-  NS_LOG_INFO(this << "  DATA rtt: " << rtt.GetSeconds() << "  " <<
-              "pacing-gain " << m_pacing_gain <<  "  " <<
-              "pacing-rate " << pacing_rate << " Mb/s  " <<
-              "bw: " << bw_est << " Mb/s  " <<
-              "m_cwnd: " << m_cwnd << " bytes  " <<
-              "tcb->m_cWnd: " << tcb->m_cWnd);
 }
 
 // Before sending packet:
-// - Record information to estimate BW
+// - Record bytes in flight
 // tsb = tcp socket base
 // tcb = transmission control block
 void TcpBbr::Send(Ptr<TcpSocketBase> tsb, Ptr<TcpSocketState> tcb,
@@ -375,33 +412,20 @@ void TcpBbr::Send(Ptr<TcpSocketBase> tsb, Ptr<TcpSocketState> tcb,
 
   NS_LOG_FUNCTION(this);
 
+  updatePacingMode(tcb);
+
   // Get the bytes in flight (needed for STARTUP/CA_RECOVERY).
   m_bytes_in_flight = tsb -> BytesInFlight();
+}
 
-  // If retransmission, start sequence (PktsAcked() finds end of sequence).
-  if (isRetrans) {
-    m_in_retrans_seq = true;
-    m_retrans_seq = seq;
-    NS_LOG_LOGIC(this << "  Starting retrans sequence: " << seq);
-  }
-
-  // If not in retrans sequence, record info for BW est (in PktsAcked()).
-  if (!m_in_retrans_seq) {
-
-    // Get last sequence number ACKed.
-    bbr::packet_struct p;
-    p.acked = tcb -> m_lastAckedSeq;
-    p.sent = seq;
-    p.time = Simulator::Now();
-    p.delivered = m_delivered;
-    m_pkt_window.push_back(p);
-  
-    NS_LOG_LOGIC(this << "  Last acked: " << p.acked <<
-                " Next sequence: " << p.sent);
-  } else {
-    NS_LOG_LOGIC(this << "  seq: " << seq <<
-                "  In retrans sequence: " << m_retrans_seq);
-  }
+// Get pacing mode of socket (may be changed at any time).
+// tcb = transmission control block
+void TcpBbr::updatePacingMode(Ptr<const TcpSocketState> tcb) {
+  if (tcb -> GetPacingMode() == m_pacing_mode)
+    return;
+  m_pacing_mode = tcb -> GetPacingMode();
+  if (m_pacing_mode == NO_PACING) 
+    NS_LOG_INFO(this << "  Note: BBR' configured with pacing NO_PACING.");
 }
 
 // Return bandwidth (maximum of window, in Mb/s).
@@ -411,16 +435,15 @@ double TcpBbr::getBW() const {
 
   NS_LOG_FUNCTION(this);
 
-  if (m_bw_window.size() == 0)
+  if (m_bw_window.empty())
 
     // Special case if no BW estimates.
     max_bw = -1.0;
 
   else
 
-    // Find max BW in window.
-    for (auto it = m_bw_window.begin(); it != m_bw_window.end(); it++)
-      max_bw = std::max(max_bw, it->bw_est);
+    // Max BW in window is kept at front of filter.
+    max_bw = std::max(max_bw, m_bw_window.getBest());
   
   NS_LOG_INFO(this << "  DATA bws in window: " << m_bw_window.size() <<
               "  max_bw: " << max_bw);
@@ -436,16 +459,15 @@ Time TcpBbr::getRTT() const {
 
   NS_LOG_FUNCTION(this);
 
-  if (m_rtt_window.size() == 0)
+  if (m_rtt_window.empty())
 
     // Special case if no RTT estimates.
     min_rtt = Time(-1.0);
 
   else
     
-    // Find minimum RTT in window.
-    for (auto it = m_rtt_window.begin(); it != m_rtt_window.end(); it++)
-      min_rtt = std::min(min_rtt, it->second);
+    // Min RTT in window is kept at front of filter.
+    min_rtt = m_rtt_window.getBest();
 
   NS_LOG_INFO(this << "  DATA rtts in window: " << m_rtt_window.size() <<
               "  min_rtt: " << min_rtt.GetSeconds());
@@ -483,39 +505,27 @@ void TcpBbr::cullBWwindow() {
 
   // Compute time delta, 10 RTTs ago until now.
   Time now = Simulator::Now();
-  Time time_delta = now - rtt * bbr::BW_WINDOW_TIME;
-  int round_delta = m_round - bbr::BW_WINDOW_TIME;
+  Time time_delta = now - rtt * m_bw_window_time;
+  int round_delta = m_round - (int) m_bw_window_time;
   
   // Erase any values that are too old.
-  auto it = m_bw_window.begin();
-  while (it != m_bw_window.end()) {
-
-    // Configured with either WALLCLOCK or PACKET time.
-    if (bbr::TIME_CONFIG == bbr::WALLCLOCK_TIME) { // Use wallclock time.
-      if (it -> time < time_delta)
-        it = m_bw_window.erase(it);
-      else
-        it++;
-    } else {                          // Use packet time.
-      if (it -> round < round_delta)
-        it = m_bw_window.erase(it);
-      else
-        it++;
-    }
-
-  }
+  // Configured with either WALLCLOCK or PACKET time.
+  if (m_time_config == bbr::WALLCLOCK_TIME)    // Use wallclock time.
+    m_bw_window.expireTime(time_delta);
+  else                                         // Use packet time.
+    m_bw_window.expireRound(round_delta);
 
-  // Log info.
+  // Log info (only samples that can still be max are kept).
   int size = m_bw_window.size();
   if (size == 0)
     NS_LOG_LOGIC(this << " BW window empty.");
   else
     NS_LOG_INFO(this << " DATA" <<
                "  m_bw_window_size: " << size <<
-                " [" << m_bw_window.begin()->round << ", " <<
-                m_bw_window.rbegin()->round << "]" << 
-                " [" << m_bw_window.begin()->time.GetSeconds() << ", " <<
-                m_bw_window.rbegin()->time.GetSeconds() << "]");
+                " [" << m_bw_window.oldest().round << ", " <<
+                m_bw_window.newest().round << "]" << 
+                " [" << m_bw_window.oldest().time.GetSeconds() << ", " <<
+                m_bw_window.newest().time.GetSeconds() << "]");
 }
 
 // Remove RTT estimates that are too old (greater than 10 seconds).
@@ -528,27 +538,30 @@ void TcpBbr::cullRTTwindow() {
   if (rtt.IsNegative())
     return;
 
-  // Compute time delta, 10 seconds ago until now.
+  // Compute time delta, RTT window (10 seconds) ago until now.
   Time now = Simulator::Now();
-  Time delta = Time(now - bbr::RTT_WINDOW_TIME * 1000000000.0); // Units are nanoseconds.
+  Time delta = now - m_rtt_window_time;
 
   // Erase any values that are too old.
-  auto it = m_rtt_window.begin();
-  while (it != m_rtt_window.end()) {
-    if (it -> first < delta)
-      it = m_rtt_window.erase(it);
-    else
-      it++;
-  }
+  m_rtt_window.expireTime(delta);
+  traceRTTwindow();
  
+  // Log info (only samples that can still be min are kept).
   int size = m_rtt_window.size();
   if (size == 0)
     NS_LOG_LOGIC(this << " RTT window empty.");
   else
     NS_LOG_INFO(this << " DATA" <<
                 "  m_rtt_window_size: " << size <<
-                " [" << m_rtt_window.begin()->first.GetSeconds() << ", " <<
-                m_rtt_window.rbegin()->first.GetSeconds() << "]");
+                " [" << m_rtt_window.oldest().time.GetSeconds() << ", " <<
+                m_rtt_window.newest().time.GetSeconds() << "]");
+}
+
+// Update traced size of RTT window.
+void TcpBbr::traceRTTwindow() {
+  m_rtt_window_size = m_rtt_window.size();
+  m_rtt_window_bytes = m_rtt_window.capacity() *
+                       sizeof(bbr::rtt_filter::sample);
 }
 
 // Return true if should enter PROBE_RTT state.
@@ -624,7 +637,7 @@ void TcpBbr::updateTargetCwnd() {
   NS_LOG_FUNCTION(this);
 
   double bdp = getBDP();
-  if (PACING_CONFIG == NO_PACING)
+  if (m_pacing_mode == NO_PACING)
     // If no pacing, cwnd is used to control pace.
     m_cwnd = bdp * m_pacing_gain;
   else
@@ -633,10 +646,10 @@ void TcpBbr::updateTargetCwnd() {
   m_cwnd = (m_cwnd * 1000000 / 8); // Mbits to bytes.
 
   // Make sure cwnd not too small (roughly, 4 packets).
-  if (m_cwnd < bbr::MIN_CWND) {
+  if (m_cwnd < m_min_cwnd) {
     NS_LOG_LOGIC(this << "  m_cwnd (bytes): " << m_cwnd <<
-                 "  Boosting to (bytes): " << bbr::MIN_CWND);
-    m_cwnd = bbr::MIN_CWND; // In bytes.
+                 "  Boosting to (bytes): " << m_min_cwnd);
+    m_cwnd = m_min_cwnd; // In bytes.
   }
 
   // Log info.
@@ -20,8 +20,11 @@
 #ifndef TCP_BBR_H
 #define TCP_BBR_H
 
+#include <functional>
+#include "ns3/traced-value.h"
 #include "tcp-congestion-ops.h"       
 #include "tcp-bbr-state.h"            
+#include "tcp-bbr-window.h"
 
 namespace ns3 {
 
@@ -32,22 +35,21 @@ namespace bbr {
 // Time configuration options (see Section 4.1.1.3 in [CCYJ17]):
 // PACKET_TIME - Use packet-time RTT for culling BW window.
 // WALLCLOCK_TIME - Use wall-clock RTT for culling BW window.
+// Set with TcpBbr attribute "TimeConfig" (default PACKET_TIME).
 enum enum_time_config {WALLCLOCK_TIME, PACKET_TIME};
 
-// Actual configuration option.
-const enum_time_config TIME_CONFIG = PACKET_TIME;
-//const enum_time_config TIME_CONFIG = WALLCLOCK_TIME;
-
 ///////////////////////////////////////////////////////////////////
 
 // Constants.
+// Those marked (*) are defaults of TcpBbr attributes, so
+// can be changed per run (e.g., --ns3::TcpBbr::StartupGain=2).
 const float VERSION = 1.7;            // See changelog.txt.
 const Time INIT_RTT = Time(1000000);  // Nanoseconds (.001 sec).
 const double INIT_BW = 6.0;           // Mb/s. 
-const int RTT_WINDOW_TIME = 10;       // In seconds.
-const int BW_WINDOW_TIME = 10;        // In RTTs.
-const int MIN_CWND = 4 * 1000;        // In bytes.
-const float PACING_FACTOR = 0.95;     // Factor of BW to pace (for tuning).
+const int RTT_WINDOW_TIME = 10;       // In seconds (*).
+const int BW_WINDOW_TIME = 10;        // In RTTs (*).
+const int MIN_CWND = 4 * 1000;        // In bytes (*).
+const float PACING_FACTOR = 0.95;     // Factor of BW to pace, for tuning (*).
   
 // PROBE_BW state:
 // Gain rates per cycle: [1.25, 0.75, 1, 1, 1, 1, 1, 1]
@@ -57,26 +59,17 @@ const float DRAIN_FACTOR = 0.25;      // Decrease when drain.
   
 // STARTUP state:
 const float STARTUP_THRESHOLD = 1.25; // Threshold to exit STARTUP.
-const float STARTUP_GAIN = 2.89;      // Roughly 2/ln(2).
+const float STARTUP_GAIN = 2.89;      // Roughly 2/ln(2) (*).
 
 // PROBE_RTT state:
 const float RTT_NOCHANGE_LIMIT = 10;  // To enter (in seconds).
-const float PROBE_RTT_MIN_TIME = 0.2; // Minimun stay time (in seconds).
-
-// Structure for tracking TCP window for estimating BW.
-struct packet_struct {
-  SequenceNumber32 acked;  // Last sequence number acked.
-  SequenceNumber32 sent;   // Next sequence number sent.
-  Time time;               // Time sent.
-  int delivered;           // Delivered bytes.
-};
+const float PROBE_RTT_MIN_TIME = 0.2; // Minimun stay time, in seconds (*).
 
-// Structure for storing BW estimates.
-struct bw_struct {
-  Time time;               // Time stored.
-  int round;               // Virtual time stored.
-  double bw_est;           // Bandwidth estimate.
-};
+// Windowed max filter for storing BW estimates.
+typedef WindowedFilter<double, std::greater<double> > bw_filter;
+
+// Windowed min filter for storing RTT estimates.
+typedef WindowedFilter<Time, std::less<Time> > rtt_filter;
 
 } // end of namespace bbr
   
@@ -114,21 +107,30 @@ public:
   virtual ~TcpBbr();
 
   // Before sending packet:
-  // - Record information to estimate BW
+  // - Record bytes in flight
   virtual void Send(Ptr<TcpSocketBase> tsb, Ptr<TcpSocketState> tcb,
                     SequenceNumber32 seq, bool isRetrans);
 
   // On receiving ack:
   // - update congestion window
   // - store RTT
-  // - compute and store estimated BW
-  // - compute and set pacing rate
   virtual void PktsAcked(Ptr<TcpSocketState> tcb, uint32_t packets_acked,
                          const Time &rtt);
 
+  // On delivery rate sample (once per ack):
+  // - update packet-timed round
+  // - store estimated BW
+  // - compute and set pacing rate
+  virtual void CongControl(Ptr<TcpSocketState> tcb,
+                           const TcpRateOps::TcpRateConnection &rc,
+                           const TcpRateOps::TcpRateSample &rs);
+
   // Copy BBR' congestion control with copy.
   virtual Ptr<TcpCongestionOps> Fork();
 
+  // Once attributes set: log configuration, enter STARTUP.
+  virtual void NotifyConstructionCompleted();
+
   // BBR' ignores calls to increase window.
   virtual void IncreaseWindow(Ptr<TcpSocketState> tcb, uint32_t segs_acked);
 
@@ -158,28 +160,43 @@ private:
   // Remove RTT estimates that are too old (greater than 10 seconds).
   void cullRTTwindow();
 
+  // Update traced size of RTT window.
+  void traceRTTwindow();
+
   // Compute target TCP cwnd (m_cwnd) based on BDP and gain.
   void updateTargetCwnd();
 
+  // Compute and set pacing rate based on BW and gain.
+  void updatePacingRate(Ptr<TcpSocketState> tcb);
+
   // Check if should enter PROBE_RTT state.
   bool checkProbeRTT();
 
+  // Get pacing mode of socket (may be changed at any time).
+  void updatePacingMode(Ptr<const TcpSocketState> tcb);
+
  protected:
   double m_pacing_gain;                    // Scale estimated BDP for pacing.
   double m_cwnd_gain;                      // Scale estimated BDP for cwnd.
+  enum_pacing_config m_pacing_mode;        // Pacing mode (from socket).
+  double m_startup_gain;                   // STARTUP gain (attribute).
+  double m_pacing_factor;                  // Factor of BW to pace (attribute).
+  uint32_t m_bw_window_time;               // BW window, in RTTs (attribute).
+  Time m_rtt_window_time;                  // RTT window (attribute).
+  Time m_probe_rtt_min_time;               // Min PROBE_RTT stay (attribute).
+  uint32_t m_min_cwnd;                     // Min cwnd, in bytes (attribute).
+  bbr::enum_time_config m_time_config;     // BW window culling (attribute).
   int m_round;                             // For recording virtual RTT time.
-  int m_delivered;                         // For computing virtual RTT rounds.
-  int m_next_round_delivered;              // For computing virtual RTT rounds.
-  std::map<Time, Time> m_rtt_window;       // For computing min RTT.
-  std::vector<bbr::bw_struct> m_bw_window; // For computing max BW.
-  std::vector<bbr::packet_struct> m_pkt_window; // For estimating BW from ACKs.
+  uint64_t m_next_round_delivered;         // For computing virtual RTT rounds.
+  bbr::rtt_filter m_rtt_window;            // For computing min RTT.
+  TracedValue<uint32_t> m_rtt_window_size; // RTT samples kept in window.
+  TracedValue<uint32_t> m_rtt_window_bytes;// Memory allocated for window.
+  bbr::bw_filter m_bw_window;              // For computing max BW.
   uint32_t m_bytes_in_flight;              // Bytes in flight (from socket base).
   Time m_min_rtt_change;                   // Last time min RTT changed.
   double m_cwnd;                           // Current taraget/max cwnd.
   double m_prior_cwnd;                     // Cwnd prior to Fast Recovery.
   Time m_packet_conservation;              // Time to stop modulation.
-  bool m_in_retrans_seq;                   // True if in retrans seq.
-  SequenceNumber32 m_retrans_seq;          // Retrans seq end.
   BbrStateMachine m_machine;               // State machine.
   BbrStartupState m_state_startup;         // STARTUP state.
   BbrDrainState m_state_drain;             // DRAIN state.
@@ -143,6 +143,23 @@ public:
   {
   }
 
+  /**
+   * \brief Update congestion state from a delivery rate sample
+   *
+   * This function mimics the function cong_control in Linux. It is called
+   * once per ACK, after the ACK has been processed (and PktsAcked called),
+   * with the rate sample generated from it.
+   *
+   * \param tcb internal congestion state
+   * \param rc connection delivery state
+   * \param rs rate sample of the ACK
+   */
+  virtual void CongControl (Ptr<TcpSocketState> tcb,
+                            const TcpRateOps::TcpRateConnection &rc,
+                            const TcpRateOps::TcpRateSample &rs)
+  {
+  }
+
   // Present in Linux but not in ns-3 yet:
   /* call when cwnd event occurs (optional) */
   // void (*cwnd_event)(struct sock *sk, enum tcp_ca_event ev);
@@ -35,6 +35,10 @@
 #include <ns3/simulator.h>
 #include <ns3/abort.h>
 #include <ns3/node.h>
+#include <ns3/boolean.h>
+#include <ns3/uinteger.h>
+
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("TcpCubic");
 
@@ -51,12 +55,52 @@ TypeId TcpCubic::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::TcpCubic")
     .SetParent<TcpSocketBase> ()
     .AddConstructor<TcpCubic> ()
+    .AddAttribute ("HyStart",
+                   "Leave slow start with HyStart++ (RFC 9406) on an RTT increase.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&TcpCubic::m_hyStart),
+                   MakeBooleanChecker ())
+    .AddAttribute ("HyStartMinRttThresh",
+                   "Lower bound of the RTT increase that ends slow start (MIN_RTT_THRESH).",
+                   TimeValue (MilliSeconds (4)),
+                   MakeTimeAccessor (&TcpCubic::m_hyStartMinRttThresh),
+                   MakeTimeChecker ())
+    .AddAttribute ("HyStartMaxRttThresh",
+                   "Upper bound of the RTT increase that ends slow start (MAX_RTT_THRESH).",
+                   TimeValue (MilliSeconds (16)),
+                   MakeTimeAccessor (&TcpCubic::m_hyStartMaxRttThresh),
+                   MakeTimeChecker ())
+    .AddAttribute ("HyStartMinRttDivisor",
+                   "The RTT increase threshold is the minimum RTT over this (MIN_RTT_DIVISOR).",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&TcpCubic::m_hyStartMinRttDivisor),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("HyStartRttSamples",
+                   "RTT samples needed in a round to check for an increase (N_RTT_SAMPLE).",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&TcpCubic::m_hyStartRttSamples),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CssGrowthDivisor",
+                   "Conservative Slow Start grows cwnd this many times slower than slow start.",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&TcpCubic::m_cssGrowthDivisor),
+                   MakeUintegerChecker<uint32_t> (2))
+    .AddAttribute ("CssRounds",
+                   "Rounds of Conservative Slow Start before congestion avoidance.",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&TcpCubic::m_cssRounds),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CwndClamp",
+                   "Upper limit of the congestion window in segments.",
+                   UintegerValue (30000),
+                   MakeUintegerAccessor (&TcpCubic::m_cWndClamp),
+                   MakeUintegerChecker<uint32_t> (2))
     .AddTraceSource ("CongestionWindowCount",
                      "Number of ACKs required to modify the congestion window.",
                      MakeTraceSourceAccessor (&TcpCubic::m_cWndCnt),
                      "ns3::TracedValueCallback::Uint32")
     .AddTraceSource ("EpochStart",
-                     "The time of the last packet loss.",
+                     "The time (us) of the last packet loss.",
                      MakeTraceSourceAccessor (&TcpCubic::m_epochStart),
                      "ns3::TracedValueCallback::Int64")
     .AddTraceSource ("CongestionWindowMax",
@@ -76,9 +120,13 @@ TypeId TcpCubic::GetTypeId (void)
                      MakeTraceSourceAccessor (&TcpCubic::m_acksNeeded),
                      "ns3::TracedValueCallback::Unit32")
     .AddTraceSource ("DelayedAcks",
-                     "Estimates the ratio of packets acked.",
+                     "Estimates the ratio of packets acked (informational only).",
                      MakeTraceSourceAccessor (&TcpCubic::m_delayedAck),
-                     "ns3::TracedValueCallback::Unit32");
+                     "ns3::TracedValueCallback::Unit32")
+    .AddTraceSource ("ConservativeSlowStart",
+                     "True while HyStart++ is in Conservative Slow Start.",
+                     MakeTraceSourceAccessor (&TcpCubic::m_inCss),
+                     "ns3::TracedValueCallback::Bool");
 
   return tid;
 }
@@ -105,13 +153,27 @@ TcpCubic::TcpCubic (void)
     m_ackCnt(0),
     m_cWndCnt(0),
     m_belowOrigin(true),
-    m_previousTimeStamp(0),
     m_acksNeeded(0),
-    m_fastConvergence(true)
+    m_fastConvergence(true),
+    m_cWndClamp(30000),
+    m_isCwndLimited(true),
+    m_maxInFlight(0),
+    m_maxInFlightSeq(0),
+    m_lastSendTime(0),
+    m_hyStart(true),
+    m_hyStartMinRttThresh(MilliSeconds (4)),
+    m_hyStartMaxRttThresh(MilliSeconds (16)),
+    m_hyStartMinRttDivisor(8),
+    m_hyStartRttSamples(8),
+    m_cssGrowthDivisor(4),
+    m_cssRounds(5),
+    m_inCss(false)
 {
   NS_LOG_FUNCTION (this);
   m_betaScale = 8*(BICTCP_BETA_SCALE+m_beta)/ 3 / (BICTCP_BETA_SCALE - m_beta);
   m_cubeRttScale = (m_bicScale * 10);
+  // TcpSocketBase starts every connection at sequence number 0.
+  HyStartReset (SequenceNumber32 (0));
 }
 
 /**
@@ -141,8 +203,27 @@ TcpCubic::TcpCubic (const TcpCubic& sock) :
   m_ackCnt(sock.m_ackCnt),
   m_cWndCnt(sock.m_cWndCnt),
   m_belowOrigin(sock.m_belowOrigin),
-  m_previousTimeStamp(sock.m_previousTimeStamp),
-  m_acksNeeded(sock.m_acksNeeded)
+  m_acksNeeded(sock.m_acksNeeded),
+  m_cWndClamp(sock.m_cWndClamp),
+  m_isCwndLimited(sock.m_isCwndLimited),
+  m_maxInFlight(sock.m_maxInFlight),
+  m_maxInFlightSeq(sock.m_maxInFlightSeq),
+  m_lastSendTime(sock.m_lastSendTime),
+  m_hyStart(sock.m_hyStart),
+  m_hyStartMinRttThresh(sock.m_hyStartMinRttThresh),
+  m_hyStartMaxRttThresh(sock.m_hyStartMaxRttThresh),
+  m_hyStartMinRttDivisor(sock.m_hyStartMinRttDivisor),
+  m_hyStartRttSamples(sock.m_hyStartRttSamples),
+  m_cssGrowthDivisor(sock.m_cssGrowthDivisor),
+  m_cssRounds(sock.m_cssRounds),
+  m_windowEnd(sock.m_windowEnd),
+  m_lastRoundMinRtt(sock.m_lastRoundMinRtt),
+  m_currentRoundMinRtt(sock.m_currentRoundMinRtt),
+  m_rttSampleCount(sock.m_rttSampleCount),
+  m_cssBaselineMinRtt(sock.m_cssBaselineMinRtt),
+  m_cssRoundCount(sock.m_cssRoundCount),
+  m_cssAcked(sock.m_cssAcked),
+  m_inCss(sock.m_inCss)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -155,56 +236,165 @@ TcpCubic::~TcpCubic (void)
 }
 
 
+/**
+ * The window grows only while cwnd limits the sender, as in Linux
+ * cubictcp_cong_avoid. Otherwise an application limited flow would grow cwnd
+ * (and later m_lastMax) far beyond what it has ever sent.
+ */
 void
-TcpCubic::CongestionAvoidance (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
+TcpCubic::IncreaseWindow (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
+{
+  NS_LOG_FUNCTION (this << tcb << segmentsAcked);
+
+  if (!IsCwndLimited (tcb))
+    {
+      NS_LOG_DEBUG("Not cwnd limited, keep cwnd " << tcb->m_cWnd);
+      return;
+    }
+  TcpNewReno::IncreaseWindow (tcb, segmentsAcked);
+}
+
+/**
+ * As tcp_is_cwnd_limited in Linux. In slow start cwnd may grow up to twice
+ * the data in flight, which lets it double every round.
+ */
+bool
+TcpCubic::IsCwndLimited (Ptr<const TcpSocketState> tcb) const
+{
+  if (m_isCwndLimited)
+    {
+      return true;
+    }
+  if (tcb->m_cWnd < tcb->m_ssThresh)
+    {
+      return tcb->m_cWnd < 2 * m_maxInFlight;
+    }
+  return false;
+}
+
+/**
+ * Called for each segment sent. Over each window of data, record the most
+ * bytes in flight and whether cwnd was what stopped the sender, as
+ * tcp_cwnd_validate in Linux. When sending resumes after an idle period,
+ * the epoch is moved by the idle time so that the cubic curve does not grow
+ * while nothing was sent (CA_EVENT_TX_START in Linux).
+ */
+void
+TcpCubic::Send (Ptr<TcpSocketBase> tsb, Ptr<TcpSocketState> tcb,
+                SequenceNumber32 seq, bool isRetrans)
+{
+  NS_LOG_FUNCTION (this << tsb << tcb << seq << isRetrans);
+
+  uint64_t now = bictcp_clock_us ();
+  uint32_t bytesInFlight = tsb->BytesInFlight ();
+  if (bytesInFlight == 0 && m_epochStart != 0 && now > m_lastSendTime)
+    {
+      int64_t idle = now - m_lastSendTime;
+      m_epochStart += idle;
+      if (m_epochStart > (int64_t) now)
+        {
+          m_epochStart = now;
+        }
+      NS_LOG_DEBUG("Idle for " << idle << " us, epoch start = " << m_epochStart);
+    }
+  m_lastSendTime = now;
+
+  // Bytes in flight including this segment.
+  bytesInFlight += tcb->m_segmentSize;
+  bool cwndLimited = bytesInFlight + tcb->m_segmentSize > tcb->m_cWnd;
+  if (tcb->m_lastAckedSeq >= m_maxInFlightSeq || bytesInFlight > m_maxInFlight
+      || cwndLimited)
+    {
+      m_maxInFlight = bytesInFlight;
+      m_maxInFlightSeq = std::max (tcb->m_highTxMark.Get (), seq + tcb->m_segmentSize);
+      m_isCwndLimited = cwndLimited;
+    }
+}
+
+/**
+ * Slow start, or Conservative Slow Start once HyStart++ has seen the RTT
+ * increase. Slow start grows cwnd by one segment per segment ACKed, up to
+ * ssthresh, as tcp_slow_start in Linux; CSS grows it by one segment every
+ * m_cssGrowthDivisor segments ACKed. Returns the segments ACKed that are
+ * left for congestion avoidance.
+ */
+uint32_t
+TcpCubic::SlowStart (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
 {
   NS_LOG_FUNCTION (this << tcb << segmentsAcked);
 
-  if (segmentsAcked > 0) 
+  uint64_t clamp = (uint64_t) m_cWndClamp * tcb->m_segmentSize;
+  if (!m_inCss)
     {
-      measure_delay(tcb);
+      uint64_t cwnd = std::min ((uint64_t) tcb->m_cWnd + (uint64_t) segmentsAcked * tcb->m_segmentSize,
+                                (uint64_t) tcb->m_ssThresh);
+      uint32_t used = (cwnd - tcb->m_cWnd + tcb->m_segmentSize - 1) / tcb->m_segmentSize;
+      tcb->m_cWnd = static_cast<uint32_t> (std::min (cwnd, clamp));
+      NS_LOG_INFO ("In SlowStart, updated to cwnd " << tcb->m_cWnd << " ssthresh " << tcb->m_ssThresh);
+      return segmentsAcked - used;
     }
 
-  // TODO:
-  // ns-3 needs to add a bytes in flight parameter to the call to CongestionAvoidance
-  // so that this check can be made.
-  // if (!tcp_is_cwnd_limited(sk, in_flight))
-  //    return;
+  m_cssAcked += segmentsAcked;
+  if (m_cssAcked >= m_cssGrowthDivisor)
+    {
+      uint64_t cwnd = tcb->m_cWnd + (uint64_t) (m_cssAcked / m_cssGrowthDivisor) * tcb->m_segmentSize;
+      tcb->m_cWnd = static_cast<uint32_t> (std::min (cwnd, clamp));
+      m_cssAcked %= m_cssGrowthDivisor;
+      NS_LOG_DEBUG("In CSS, updated to cwnd " << tcb->m_cWnd);
+    }
+  return 0;
+}
 
 
+/**
+ * Congestion avoidance as cubictcp_cong_avoid and tcp_cong_avoid_ai in Linux:
+ * cwnd grows by one segment every m_acksNeeded segments ACKed, whether they
+ * were ACKed one by one or by a delayed or stretch ACK.
+ */
+void
+TcpCubic::CongestionAvoidance (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
+{
+  NS_LOG_FUNCTION (this << tcb << segmentsAcked);
+
+  if (segmentsAcked == 0)
+    {
+      return;
+    }
+
   // The ns-2 cubic implementation has a call to check
   // for slow start, but this is handled in tcp-congestion-ops
   // so it is not needed here.
-  CubicUpdate(tcb);
-  
+  CubicUpdate(tcb, segmentsAcked);
 
   /* In dangerous area, increase slowly.
    * In theory this is tp->snd_cwnd += 1 / tp->snd_cwnd
    */
-  if (m_cWndCnt >= m_acksNeeded)
-    {
-      // TODO:
-      // In Linux CUBIC there is a check to ensure the sending congestion
-      // window is smaller than a maximum possible size before updating:
-      //
-      // if (tp->snd_cwnd < tp->snd_cwnd_clamp)
-      //
-      // ns-3 does not provide a snd_cwnd_clamp variable so this code uses
-      // the vlaue 30,000 segments. This comes from checking the settings
-      // used in ns-2.35
-      if (tcb->m_cWnd < (30000u * tcb->m_segmentSize))
-        {
-          tcb->m_cWnd += tcb->m_segmentSize;
-        } 
-      NS_LOG_DEBUG("Increment cwnd to " << tcb->m_cWnd << " there were " << m_cWndCnt << " ACKs");
+  uint32_t acksNeeded = m_acksNeeded;
+  uint32_t increment = 0;
+  if (m_cWndCnt >= acksNeeded)
+    {
       m_cWndCnt = 0;
+      increment++;
+    }
+  m_cWndCnt += segmentsAcked;
+  if (m_cWndCnt >= acksNeeded)
+    {
+      uint32_t delta = m_cWndCnt / acksNeeded;
+      m_cWndCnt -= delta * acksNeeded;
+      increment += delta;
+    }
+
+  uint32_t cwndSeg = tcb->GetCwndInSegments ();
+  increment = std::min (increment, cwndSeg < m_cWndClamp ? m_cWndClamp - cwndSeg : 0);
+  if (increment > 0)
+    {
+      tcb->m_cWnd += increment * tcb->m_segmentSize;
+      NS_LOG_DEBUG("Increment cwnd to " << tcb->m_cWnd);
     }
   else
     {
-      m_cWndCnt +=1;
       NS_LOG_DEBUG("Not enough segments have been ACKed to increment cwnd. ACKed " << m_cWndCnt << " need " << m_acksNeeded);
     }
-
 }
 
 
@@ -223,6 +413,10 @@ TcpCubic::GetSsThresh (Ptr<const TcpSocketState> tcb,
       CubicReset();
     }
 
+  // A loss ends slow start, also in CSS. Samples from before the loss are
+  // not used if slow start is entered again after a timeout.
+  HyStartReset (tcb->m_highTxMark);
+
   uint32_t cwndSeg = tcb->GetCwndInSegments();
   m_epochStart = 0;
 
@@ -236,7 +430,8 @@ TcpCubic::GetSsThresh (Ptr<const TcpSocketState> tcb,
       m_lastMax = cwndSeg;
     }
   NS_LOG_DEBUG("m_lastMax updated: " << m_lastMax);
-  m_lastTime = tcb->m_rcvTimestampEchoReply;
+  // Compute the ACK count needed again in the new epoch.
+  m_lastCwnd = 0;
 
   m_lastMax = cwndSeg;
 
@@ -267,111 +462,173 @@ TcpCubic::PktsAcked (Ptr<TcpSocketState> tcb, uint32_t packetsAcked,
       m_delayedAck += packetsAcked;
       NS_LOG_DEBUG("  Delayed Ack = " << m_delayedAck);
     }
-}
 
-/**
- * Return the index of the last set bit. In the original Linux implementation
- * this method is provided in the Linux Kernel. This method is copied from the
- * the ns-2 TCP package.
- */
-uint32_t
-TcpCubic::fls64 (uint64_t x)
-{
-  uint32_t h = x >> 32;
-  if (h)
+  // rtt is the smoothed estimate, repeated on ACKs without a sample, so
+  // the delay and HyStart++ take the sample of this ACK, as in Linux.
+  measure_delay (tcb->m_rttSample);
+
+  if (m_hyStart && tcb->m_cWnd < tcb->m_ssThresh
+      && tcb->m_congState == TcpSocketState::CA_OPEN)
     {
-      return fls(h) + 32;
+      HyStartUpdate (tcb, tcb->m_rttSample);
     }
-  return fls(x);
 }
 
 /**
- * Return the index of the last set bit. The ns-2 implementation of the method
- * fls64 uses this method with normal integers. This method is copied from the
- * ns-2 TCP package.
+ * HyStart++ as in RFC 9406 section 4.2. A round starts when the data sent at
+ * the start of the previous round has been ACKed.
  */
-int
-TcpCubic::fls (int x)
+void
+TcpCubic::HyStartUpdate (Ptr<TcpSocketState> tcb, const Time& rtt)
 {
-  int r = 32;
-
-  if (!x)
-    {
-      return 0;
-    }
-  if (!(x & 0xffff0000u))
+  if (tcb->m_lastAckedSeq >= m_windowEnd)
     {
-      x <<= 16;
-      r -= 16;
+      m_windowEnd = tcb->m_highTxMark;
+      m_lastRoundMinRtt = m_currentRoundMinRtt;
+      m_currentRoundMinRtt = Time::Max ();
+      m_rttSampleCount = 0;
+
+      if (m_inCss && ++m_cssRoundCount >= m_cssRounds)
+        {
+          NS_LOG_DEBUG("HyStart++ leaves slow start after " << m_cssRoundCount
+            << " CSS rounds, ssthresh = " << tcb->m_cWnd);
+          tcb->m_ssThresh = tcb->m_cWnd;
+          HyStartReset (m_windowEnd);
+          return;
+        }
     }
-  if (!(x & 0xff000000u))
+
+  // No RTT sample on this ACK (e.g., a duplicate ACK).
+  if (rtt.IsZero ())
     {
-      x <<= 8;
-      r -= 8;
+      return;
     }
-  if (!(x & 0xf0000000u))
+  m_currentRoundMinRtt = std::min (m_currentRoundMinRtt, rtt);
+  m_rttSampleCount++;
+  if (m_rttSampleCount < m_hyStartRttSamples)
     {
-      x <<= 4;
-      r -= 4;
+      return;
     }
-  if (!(x & 0xc0000000u))
+
+  if (!m_inCss)
     {
-      x <<= 2;
-      r -= 2;
+      if (m_lastRoundMinRtt == Time::Max ())
+        {
+          return;
+        }
+      Time thresh = NanoSeconds (m_lastRoundMinRtt.GetNanoSeconds () / m_hyStartMinRttDivisor);
+      thresh = std::max (m_hyStartMinRttThresh, std::min (thresh, m_hyStartMaxRttThresh));
+      if (m_currentRoundMinRtt >= m_lastRoundMinRtt + thresh)
+        {
+          NS_LOG_DEBUG("HyStart++ enters CSS, RTT " << m_lastRoundMinRtt
+            << " -> " << m_currentRoundMinRtt << ", cwnd = " << tcb->m_cWnd);
+          m_cssBaselineMinRtt = m_currentRoundMinRtt;
+          m_cssRoundCount = 0;
+          m_cssAcked = 0;
+          m_inCss = true;
+        }
     }
-  if (!(x & 0x80000000u))
+  else if (m_currentRoundMinRtt < m_cssBaselineMinRtt)
     {
-      x <<= 1;
-      r -= 1;
+      // The RTT increase was spurious: resume slow start.
+      NS_LOG_DEBUG("HyStart++ resumes slow start, RTT " << m_currentRoundMinRtt
+        << " < " << m_cssBaselineMinRtt);
+      m_cssBaselineMinRtt = Time::Max ();
+      m_inCss = false;
     }
-  return r;
 }
 
+void
+TcpCubic::HyStartReset (SequenceNumber32 windowEnd)
+{
+  m_windowEnd = windowEnd;
+  m_lastRoundMinRtt = Time::Max ();
+  m_currentRoundMinRtt = Time::Max ();
+  m_rttSampleCount = 0;
+  m_cssBaselineMinRtt = Time::Max ();
+  m_cssRoundCount = 0;
+  m_cssAcked = 0;
+  m_inCss = false;
+}
+
+namespace {
+
+/*
+ * Table of cbrt(m) << 12 for m in [0, 512], generated at compile time. C++11
+ * constexpr functions are a single return statement, so the integer cube
+ * root is a recursive binary search and the table is expanded from a
+ * parameter pack.
+ */
+constexpr uint64_t
+Cube (uint64_t x)
+{
+  return x * x * x;
+}
+
+constexpr uint32_t
+CubeRootSearch (uint64_t a, uint64_t lo, uint64_t hi)
+{
+  return lo == hi ? lo
+         : Cube ((lo + hi + 1) / 2) <= a ? CubeRootSearch (a, (lo + hi + 1) / 2, hi)
+         : CubeRootSearch (a, lo, (lo + hi + 1) / 2 - 1);
+}
+
+constexpr uint16_t
+CubeRootEntry (uint32_t m)
+{
+  return CubeRootSearch ((uint64_t) m << 36, 0, 1 << 16);
+}
+
+template <uint16_t... V>
+struct CubeRootTable
+{
+  static const uint16_t v[sizeof... (V)];
+};
+
+template <uint16_t... V>
+const uint16_t CubeRootTable<V...>::v[sizeof... (V)] = { V... };
+
+template <uint32_t N, uint16_t... V>
+struct MakeCubeRootTable : MakeCubeRootTable<N - 1, CubeRootEntry (N - 1), V...>
+{
+};
+
+template <uint16_t... V>
+struct MakeCubeRootTable<0, V...>
+{
+  typedef CubeRootTable<V...> type;
+};
+
+typedef MakeCubeRootTable<513>::type CubeRoots;
+
+} // namespace
+
 /**
  * The CUBIC algorithm in Linux and ns-2 does not use the normal C++ pow
- * function to take the cubed root. Instead it uses its own method. While
- * this method does not produce a perfect cubed root it is what CUBIC uses.
+ * function to take the cubed root. Instead it uses a table lookup followed by
+ * one Newton-Raphson iteration. The Linux table has 64 hand-refined entries,
+ * which leaves an error of about 0.2%; this one has 512 and interpolates
+ * between them, so that the Newton-Raphson iteration is within 1 of the exact
+ * root. test/tcp-cubic-root-bench.cc compares both.
  */
 uint32_t
 TcpCubic::CubicRoot (uint64_t a)
 {
-  uint32_t x, b, shift;
-  /*
-   * cbrt(x) MSB values for x MSB values in [0..63].
-   * Precomputed then refined by hand - Willy Tarreau
-   *
-   * For x in [0..63],
-   *   v = cbrt(x << 18) - 1
-   *   cbrt(x) = (v[x] + 10) >> 6
-   */
-  static const uint8_t v[] = {
-    /* 0x00 */    0,   54,   54,   54,  118,  118,  118,  118,
-    /* 0x08 */  123,  129,  134,  138,  143,  147,  151,  156,
-    /* 0x10 */  157,  161,  164,  168,  170,  173,  176,  179,
-    /* 0x18 */  181,  185,  187,  190,  192,  194,  197,  199,
-    /* 0x20 */  200,  202,  204,  206,  209,  211,  213,  215,
-    /* 0x28 */  217,  219,  221,  222,  224,  225,  227,  229,
-    /* 0x30 */  231,  232,  234,  236,  237,  239,  240,  242,
-    /* 0x38 */  244,  245,  246,  248,  250,  251,  252,  254,
-  };
-  b = fls64(a);
-
-  NS_LOG_DEBUG("  CubicRoot: a = " << a);
-  NS_LOG_DEBUG("  CubicRoot: b = " << b);
-
-  if (b < 7)
+  uint32_t b = fls64 (a);
+  if (b <= 9)
     {
-      /* a in [0..63] */
-      return ((uint32_t)v[(uint32_t)a] + 35) >> 6;
+      /* a in [0..511] */
+      return CubeRoots::v[a] >> 12;
     }
 
-  b = ((b * 84) >> 8) - 1;
-  shift = (a >> (b * 3));
-  x = ((uint32_t)(((uint32_t)v[shift] + 10) << b)) >> 6;
-
-  NS_LOG_DEBUG("  CubicRoot: b = " << b);
-  NS_LOG_DEBUG("  CubicRoot: shift = " << shift);
-  NS_LOG_DEBUG("  CubicRoot: x = " << x);
+  // a = m * 2^(3 * shift) with m in [64..511], so cbrt(a) = cbrt(m) << shift.
+  uint32_t shift = (b - 7) / 3;
+  uint32_t m = a >> (3 * shift);
+  uint64_t rest = a & ((1ull << (3 * shift)) - 1);
+  uint32_t frac = 3 * shift >= 16 ? rest >> (3 * shift - 16) : rest << (16 - 3 * shift);
+  uint64_t y = CubeRoots::v[m]
+    + (((uint64_t) (CubeRoots::v[m + 1] - CubeRoots::v[m]) * frac) >> 16);
+  uint64_t x = ((y << shift) + (1 << 11)) >> 12;
 
   /*
    * Newton-Raphson iteration
@@ -379,56 +636,48 @@ TcpCubic::CubicRoot (uint64_t a)
    * x    = ( 2 * x  +  a / x  ) / 3
    *  k+1          k         k
    */
-  // NOTE:
-  // The Linux and ns-2 implementation use the method div64_64 to divide these
-  // numbers as not all systems support 64 bit numbers. I could not find a
-  // similar method in C++ so for now this code assumes that 64 bit numbers are
-  // supported.
-  //x = (2 * x + (uint32_t)div64_64(a, (uint64_t)x * (uint64_t)(x - 1)));
-  x = (2 * x + (uint32_t)(a / ((uint64_t)x * (uint64_t)(x - 1))));
-  x = ((x * 341) >> 10);
-
-  NS_LOG_DEBUG("  CubicRoot: x = " << x);
-  return x;
+  return (2 * x + a / (x * x)) / 3;
 }
 
 
-uint32_t
-TcpCubic::tcp_time_stamp ()
+uint64_t
+TcpCubic::bictcp_clock_us ()
 {
-  uint64_t now = (uint64_t) Simulator::Now ().GetMilliSeconds ();
-  return (now & 0xFFFFFFFF);
+  return Simulator::Now ().GetMicroSeconds ();
 }
 
+/**
+ * Keep the smallest RTT sample, in microseconds, as cubictcp_acked in Linux.
+ * ns-2 took the delay from the echoed TCP timestamp, which counts whole
+ * milliseconds and so cannot tell RTTs below a millisecond apart.
+ */
 void
-TcpCubic::measure_delay (Ptr<TcpSocketState> tcb)
+TcpCubic::measure_delay (const Time& rtt)
 {
-  /* Discard delay samples right after fast recovery */
-  if( tcp_time_stamp() - m_epochStart < HZ)
+  // No RTT sample on this ACK (e.g., a duplicate ACK).
+  if (rtt.IsZero ())
     {
       return;
     }
 
-  // Calculate delay
-  uint32_t delay = (tcp_time_stamp() - tcb->m_rcvTimestampEchoReply) << 3;
-
-  NS_LOG_DEBUG("Calculate delay = (new_timestamp - echo-from-ack) << 3\n  "
-    << delay << " = ( " << tcp_time_stamp() << " - " << tcb->m_rcvTimestampEchoReply
-    << ") << 3" );
+  /* Discard delay samples right after fast recovery */
+  if (m_epochStart != 0 && bictcp_clock_us () - m_epochStart < USEC_PER_SEC)
+    {
+      return;
+    }
 
+  uint32_t delay = rtt.GetMicroSeconds ();
   if(delay == 0)
     {
       delay = 1;
       NS_LOG_DEBUG("Delay cannot be 0, set to 1");
     }
 
-  m_previousTimeStamp = tcb->m_rcvTimestampEchoReply;
-
   // Take this chance to update m_dMin
   if(m_dMin == 0 || m_dMin > delay)
     {
       m_dMin = delay;
-      NS_LOG_DEBUG("Update delay to " << m_dMin);
+      NS_LOG_DEBUG("Update delay to " << m_dMin << " us");
     }
 }
 
@@ -439,7 +688,7 @@ TcpCubic::measure_delay (Ptr<TcpSocketState> tcb)
  * standard CUBIC update for a concave or convex region.
  */
 void
-TcpCubic::CubicUpdate (Ptr<TcpSocketState> tcb)
+TcpCubic::CubicUpdate (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
 {
   NS_LOG_DEBUG("Run a CUBIC update: Time " << Simulator::Now ().GetSeconds () << " seconds");
 
@@ -451,43 +700,41 @@ TcpCubic::CubicUpdate (Ptr<TcpSocketState> tcb)
   // The new congestion window size recommended by CUBIC.
   uint32_t cnt, min_cnt = 0;
 
-  // Increment the number of ACKs counted
-  m_ackCnt += 1;
+  // Count the segments ACKed
+  m_ackCnt += segmentsAcked;
 
 
   // Only make another check for updates if the congestion window was just updated or
   // a certain amount of time has passed.
-  if ( m_lastCwnd == cwndSeg &&
-       (int32_t)(tcp_time_stamp() - m_lastTime) <= HZ / 32)
+  uint64_t now = bictcp_clock_us ();
+  if ( m_lastCwnd == cwndSeg && now - m_lastTime <= USEC_PER_SEC / 32)
     {
       NS_LOG_DEBUG("  m_lastCwnd = cwndSeg = " << cwndSeg
-        << " and (tcp_time_stamp - m_lastTime) <= HZ / 32 \n ("
-        << tcb->m_rcvTimestampEchoReply << " - " << m_lastTime
-        << ") <= " << HZ << " / 32" );
+        << " and (now - m_lastTime) <= USEC_PER_SEC / 32 \n ("
+        << now << " - " << m_lastTime << ") <= " << USEC_PER_SEC << " / 32" );
       return;
     }
   else
     {
       NS_LOG_DEBUG("  m_lastCwnd = " << m_lastCwnd << " cwndSeg = "
-        << cwndSeg << " and (tcp_time_stamp - m_lastTime) <= HZ / 32 \n "
-        << tcb->m_rcvTimestampEchoReply << " - " << m_lastTime << " = "
-        << (tcb->m_rcvTimestampEchoReply - m_lastTime) << "  <=  "
-        << HZ << " / 32 = " << (HZ / 32) );
+        << cwndSeg << " or (now - m_lastTime) > USEC_PER_SEC / 32 \n "
+        << now << " - " << m_lastTime << " = " << (now - m_lastTime)
+        << "  >  " << USEC_PER_SEC << " / 32 = " << (USEC_PER_SEC / 32) );
     }
 
 
   m_lastCwnd = cwndSeg; 
-  m_lastTime = tcp_time_stamp();
+  m_lastTime = now;
 
 
   // If there has not been a packet drop yet
   if (m_epochStart == 0)
     {
       // Record the beginning of an epoch.
-      m_epochStart = tcp_time_stamp();
+      m_epochStart = now;
       NS_LOG_DEBUG("  Epoch start = " << m_epochStart);
 
-      m_ackCnt = 1;
+      m_ackCnt = segmentsAcked;
       m_tcpCwnd = cwndSeg;
 
       NS_LOG_DEBUG("Is Wmax < current CWND?  Wmax = " << m_lastMax << " CWND = " << cwndSeg);
@@ -518,12 +765,12 @@ TcpCubic::CubicUpdate (Ptr<TcpSocketState> tcb)
   // Next calculate 't' or the current time since epoch. When the value of
   // 't' is equal to 'K' then the CUBIC algorithm should have reached the
   // origin or Wmax point.
-  uint32_t t = ((tcp_time_stamp() - m_epochStart + (m_dMin>>3))
-                 << BICTCP_HZ) / HZ;
+  // t counts 1/2^BICTCP_HZ s, so that it fits in 32 bits for about 48 days.
+  uint32_t t = ((now - m_epochStart + m_dMin) << BICTCP_HZ) / USEC_PER_SEC;
 
-   NS_LOG_DEBUG("  t = ((tcp_time_stamp() - m_epochStart + (m_dMin>>3)) << BICTCP_HZ) / HZ \n  t = (("
-     << tcp_time_stamp() << " - " << m_epochStart << " + (" << m_dMin
-     << ">>3)) << " << BICTCP_HZ << ") / " << HZ << "\n  t = " << t );
+   NS_LOG_DEBUG("  t = ((now - m_epochStart + m_dMin) << BICTCP_HZ) / USEC_PER_SEC \n  t = (("
+     << now << " - " << m_epochStart << " + " << m_dMin
+     << ") << " << BICTCP_HZ << ") / " << USEC_PER_SEC << "\n  t = " << t );
 
   // Calculate t - K for CUBIC. In Linux and ns-2 this is done with checks to
   // make sure the result is positive
@@ -609,9 +856,9 @@ TcpCubic::CubicUpdate (Ptr<TcpSocketState> tcb)
     {
       NS_LOG_DEBUG("  m_dMin > 0: " << m_dMin);
       /* max increment = Smax * rtt / 0.1  */
-      min_cnt = (cwndSeg * HZ * 8)/(10 * m_maxIncrement * m_dMin);
-      NS_LOG_DEBUG("  min_cnt = (cwndSeg * HZ * 8)/(10 * m_maxIncrement * m_dMin)\n  "
-        << min_cnt << " = (" << cwndSeg << " * " << HZ << " * 8)/(10 * "
+      min_cnt = ((uint64_t) cwndSeg * USEC_PER_SEC)/(10 * m_maxIncrement * m_dMin);
+      NS_LOG_DEBUG("  min_cnt = (cwndSeg * USEC_PER_SEC)/(10 * m_maxIncrement * m_dMin)\n  "
+        << min_cnt << " = (" << cwndSeg << " * " << USEC_PER_SEC << ")/(10 * "
         << m_maxIncrement << " * " << m_dMin << ")" );
 
       /* use concave growth when the target is above the origin */
@@ -640,12 +887,11 @@ TcpCubic::CubicUpdate (Ptr<TcpSocketState> tcb)
       NS_LOG_DEBUG("TCP Friendly cnt = " << cnt);
     }
 
-  NS_LOG_DEBUG("  cnt = (cnt << ACK_RATIO_SHIFT) / m_delayedAck: cnt = ("
-    << cnt << " << " << ACK_RATIO_SHIFT << ") / " << m_delayedAck);
-  cnt = (cnt << ACK_RATIO_SHIFT) / m_delayedAck;
-  if ( cnt == 0 ) // cannot be zero
+  // Growth is counted in segments ACKed, so unlike ns-2 cnt is not scaled by
+  // the delayed ACK ratio. At most 1.5 times per RTT, as in Linux.
+  if (cnt < 2)
     {
-      cnt = 1;
+      cnt = 2;
     }
 
 
@@ -38,8 +38,8 @@
 /** Constant used to convert units of time. */
 #define BICTCP_HZ 10
 
-/** Constant used to convert units of time. */
-#define HZ 1000
+/** The CUBIC clock counts microseconds, as bictcp_clock_us in Linux. */
+#define USEC_PER_SEC 1000000
 
 /** Constant used to bit shift ACK counts. */
 #define ACK_RATIO_SHIFT 4
@@ -85,46 +85,56 @@ public:
   virtual void PktsAcked (Ptr<TcpSocketState> tcb, uint32_t packetsAcked,
                           const Time& rtt);
 
+  virtual void IncreaseWindow (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked);
+
+  virtual void Send (Ptr<TcpSocketBase> tsb, Ptr<TcpSocketState> tcb,
+                     SequenceNumber32 seq, bool isRetrans);
+
+  /**
+   * Integer cube root, used to find K. As in Linux a table lookup gives a
+   * first estimate that one Newton-Raphson iteration refines; the table is
+   * generated at compile time and interpolated, so the result is within 1 of
+   * the exact cube root over the full 64-bit range.
+   * @param a The number to get the cube root of.
+   * @return The cube root of a.
+   */
+  static uint32_t CubicRoot (uint64_t a);
+
 
 protected:
+  virtual uint32_t SlowStart (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked);
   virtual void CongestionAvoidance (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked);
 
 private:
 
   /**
-   * Return the index of the last set bit. In the original Linux implementation
-   * this method is provided in the Linux Kernel. This method is copied from the
-   * the ns-2 TCP package.
+   * Return the index of the last set bit, counting from 1, as fls64 in the
+   * Linux Kernel.
    * @param a The number to get the last set bit of.
-   * @return The index of the last set bit.
+   * @return The index of the last set bit, 0 if a is 0.
    */
-  uint32_t fls64 (uint64_t a);
+  static uint32_t fls64 (uint64_t a)
+  {
+    return a == 0 ? 0 : 64 - __builtin_clzll (a);
+  }
 
-  /**
-   * Return the index of the last set bit. The ns-2 implementation of the method
-   * fls64 uses this method with normal integers. This method is copied from the
-   * ns-2 TCP package.
-   * @param x The number to get the last set bit of.
-   * @return The index of the last set bit.
-   */
-  int fls (int x);
-
-  /**
-   * The CUBIC algorithm in Linux and ns-2 does not use the normal C++ pow
-   * function to take the cubed root. Instead they use their own method. While
-   * this method does not produce a perfect cubed root it is what CUBIC uses.
-   * @param a The number to get the CUBIC root of.
-   * @return The cubic root of the parameter a.
-   */
-  uint32_t CubicRoot (uint64_t a);
-  
   /**
    * Get the next size of the congestion window using the CUBIC update algorithm.
    * Depending on the current situation this could be a TCP Friendly update or a
    * standard CUBIC update for a concave or convex region.
    * @param tcb The current socket state.
+   * @param segmentsAcked The number of segments the ACK acknowledged.
+   */
+  void CubicUpdate (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked);
+
+  /**
+   * Check if the sender has been limited by cwnd rather than by the
+   * application, as tcp_is_cwnd_limited in Linux. cwnd does not grow
+   * otherwise.
+   * @param tcb The current socket state.
+   * @return True if cwnd may grow.
    */
-  void CubicUpdate (Ptr<TcpSocketState> tcb);
+  bool IsCwndLimited (Ptr<const TcpSocketState> tcb) const;
 
   /**
    * Modify the number of ACKs CUBIC needs before updating the congestion
@@ -142,17 +152,34 @@ private:
    */
   void CubicReset ();
 
+  /**
+   * HyStart++ (RFC 9406) round tracking and delay increase detection, run for
+   * every ACK in slow start. Enters Conservative Slow Start (CSS) when the
+   * minimum RTT of a round has grown by more than the threshold, goes back to
+   * slow start if the RTT falls again, and leaves slow start after
+   * m_cssRounds rounds of CSS.
+   * @param tcb The current socket state.
+   * @param rtt The RTT sample of this ACK, zero if it has none.
+   */
+  void HyStartUpdate (Ptr<TcpSocketState> tcb, const Time& rtt);
+
+  /**
+   * Forget the HyStart++ RTT history. Called at initialization and for losses.
+   * @param windowEnd The end of the first round.
+   */
+  void HyStartReset (SequenceNumber32 windowEnd);
+
   /*
    * Measure the lowest delay for receiving ACKs.
-   * @param tcb The current socket state.
+   * @param rtt The RTT sample of the ACK.
    */
-  void measure_delay (Ptr<TcpSocketState> tcb);
+  void measure_delay (const Time& rtt);
 
   /*
-   * Return the TCP timestamp (based on simulation time in ms).
-   * @return The simulation time in milliseconds.
+   * Return the CUBIC clock (based on simulation time in us).
+   * @return The simulation time in microseconds.
    */
-  uint32_t tcp_time_stamp ();
+  uint64_t bictcp_clock_us ();
 
 
 protected:
@@ -192,17 +219,20 @@ protected:
    */
   int m_maxIncrement;
 
-  /** Estimate the ratio of Packets/ACKs << 4 */
+  /**
+   * Estimate the ratio of Packets/ACKs << 4. The window growth counts the
+   * segments ACKed instead, so this is only traced.
+   */
   TracedValue<uint32_t> m_delayedAck;
 
   /**
-   * The time the last congestion window reduction occured. This is used to
-   * find the elapsed time 't' used in the Cubic algorithm.
+   * The time (us) the last congestion window reduction occured. This is used
+   * to find the elapsed time 't' used in the Cubic algorithm.
    */
   TracedValue<int64_t> m_epochStart;
 
-  /** Time when the CUBIC w_max (m_lastMax here) was updated last. */
-  uint32_t m_lastTime;
+  /** Time (us) when the ACK count needed (m_acksNeeded) was updated last. */
+  uint64_t m_lastTime;
 
   /** The congestion window size just before the last reduction. */
   TracedValue<uint32_t> m_lastMax;
@@ -215,7 +245,7 @@ protected:
    */
   double m_k;
 
-  /** The shortest RTT observed. */ 
+  /** The shortest RTT observed (us). */
   uint32_t m_dMin;
 
   /** The starting size of the congestion window at the last window reduction. */
@@ -227,13 +257,10 @@ protected:
   /** Flag for TCP Friendly region. */
   bool m_tcpFriendly;
 
-  /** 
-   * Count of ACKs. Due to the ns-3 implementation of using bytes instead of
-   * packets this has been implemented as the number of bytes ACKed.
-   */
+  /** Count of segments ACKed, for the TCP friendly window. */
   uint32_t m_ackCnt;
 
-  /** Track the number of segments acked since the last cwnd increment.. */
+  /** Track the number of segments acked since the last cwnd increment. */
   TracedValue<uint32_t> m_cWndCnt;
 
   /**
@@ -242,10 +269,7 @@ protected:
    */
   TracedValue<bool> m_belowOrigin;
 
-  /** Store the last TCP timestamp to calculate the shortest RTT. */
-  uint32_t m_previousTimeStamp;
-
-  /** The number of ACKs needed to update cwnd. */
+  /** The number of segments to be ACKed for each cwnd increment. */
   TracedValue<uint32_t> m_acksNeeded;
 
   /**
@@ -254,6 +278,66 @@ protected:
    * additional factor.
    */
   bool m_fastConvergence;
+
+  /** Upper limit of cwnd in segments (snd_cwnd_clamp in Linux). */
+  uint32_t m_cWndClamp;
+
+  /** cwnd limited the sender in the window of data being ACKed. */
+  bool m_isCwndLimited;
+
+  /** Most bytes in flight in the window of data being ACKed. */
+  uint32_t m_maxInFlight;
+
+  /** The window of data being ACKed ends at this sequence number. */
+  SequenceNumber32 m_maxInFlightSeq;
+
+  /** Time (us) the last segment was sent. */
+  uint64_t m_lastSendTime;
+
+  /** Use HyStart++ to leave slow start before the first loss. */
+  bool m_hyStart;
+
+  /** Lower bound of the RTT increase that ends slow start. */
+  Time m_hyStartMinRttThresh;
+
+  /** Upper bound of the RTT increase that ends slow start. */
+  Time m_hyStartMaxRttThresh;
+
+  /** The RTT increase threshold is the last round's minimum RTT over this. */
+  uint32_t m_hyStartMinRttDivisor;
+
+  /** RTT samples needed in a round before checking for a delay increase. */
+  uint32_t m_hyStartRttSamples;
+
+  /** CSS grows cwnd this many times slower than slow start. */
+  uint32_t m_cssGrowthDivisor;
+
+  /** Rounds of CSS before entering congestion avoidance. */
+  uint32_t m_cssRounds;
+
+  /** The current round ends when this sequence number is ACKed. */
+  SequenceNumber32 m_windowEnd;
+
+  /** Minimum RTT of the previous round. */
+  Time m_lastRoundMinRtt;
+
+  /** Minimum RTT of the current round. */
+  Time m_currentRoundMinRtt;
+
+  /** RTT samples in the current round. */
+  uint32_t m_rttSampleCount;
+
+  /** Minimum RTT of the round in which CSS was entered. */
+  Time m_cssBaselineMinRtt;
+
+  /** Completed rounds of CSS. */
+  uint32_t m_cssRoundCount;
+
+  /** Segments ACKed in CSS since the last cwnd increment. */
+  uint32_t m_cssAcked;
+
+  /** Flag for the Conservative Slow Start phase of HyStart++. */
+  TracedValue<bool> m_inCss;
 };
 
 } // namespace ns3
@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "tcp-pacing-scheduler.h"
+#include "tcp-socket-base.h"
+#include "ns3/node.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpPacingScheduler");
+NS_OBJECT_ENSURE_REGISTERED (TcpPacingScheduler);
+
+TypeId
+TcpPacingScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpPacingScheduler")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpPacingScheduler> ()
+    .AddAttribute ("Quantum",
+                   "Bytes a flow may release at a time before waiting for "
+                   "them to drain at its pacing rate (0 for one packet)",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpPacingScheduler::m_quantum),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TimerSlack",
+                   "Flows due within this time of the timer are released "
+                   "by it, too",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&TcpPacingScheduler::m_timerSlack),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+TcpPacingScheduler::TcpPacingScheduler ()
+  : Object (),
+    m_eventTime (Seconds (0)),
+    m_quantum (0),
+    m_timerSlack (Seconds (0))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpPacingScheduler::~TcpPacingScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TcpPacingScheduler::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  m_scheduled.clear ();
+  m_flows.clear ();
+  Object::DoDispose ();
+}
+
+Ptr<TcpPacingScheduler>
+TcpPacingScheduler::GetScheduler (Ptr<Node> node)
+{
+  Ptr<TcpPacingScheduler> scheduler = node->GetObject<TcpPacingScheduler> ();
+  if (scheduler == 0)
+    {
+      scheduler = CreateObject<TcpPacingScheduler> ();
+      node->AggregateObject (scheduler);
+    }
+  return scheduler;
+}
+
+void
+TcpPacingScheduler::Enqueue (Ptr<TcpSocketBase> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+
+  if (m_scheduled.find (PeekPointer (socket)) != m_scheduled.end ())
+    {
+      return;
+    }
+
+  // A flow that was idle may send as soon as its last release has drained
+  Time time = Max (socket->m_pacing_next, Simulator::Now ());
+  Insert (socket, time);
+
+  // Move the timer earlier if this flow is now the first due
+  if (!m_event.IsRunning () || time < m_eventTime)
+    {
+      m_event.Cancel ();
+      m_eventTime = time;
+      m_event = Simulator::Schedule (time - Simulator::Now (),
+                                     &TcpPacingScheduler::Release, this);
+      NS_LOG_LOGIC (this << " Timer set for " << time.GetSeconds ());
+    }
+}
+
+void
+TcpPacingScheduler::Remove (TcpSocketBase *socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+
+  std::map<TcpSocketBase *, FlowQueue::iterator>::iterator it =
+    m_scheduled.find (socket);
+  if (it == m_scheduled.end ())
+    {
+      return;
+    }
+  m_flows.erase (it->second);
+  m_scheduled.erase (it);
+
+  if (m_flows.empty ())
+    {
+      m_event.Cancel ();
+    }
+}
+
+void
+TcpPacingScheduler::Insert (Ptr<TcpSocketBase> socket, Time time)
+{
+  m_scheduled[PeekPointer (socket)] = m_flows.insert (std::make_pair (time, socket));
+}
+
+void
+TcpPacingScheduler::Release (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now ();
+  while (!m_flows.empty () && m_flows.begin ()->first <= now + m_timerSlack)
+    {
+      Ptr<TcpSocketBase> socket = m_flows.begin ()->second;
+      m_scheduled.erase (PeekPointer (socket));
+      m_flows.erase (m_flows.begin ());
+
+      // Release at least one packet, up to the quantum
+      uint32_t bytes = 0;
+      uint32_t sz;
+      do
+        {
+          sz = socket->SendPacedPacket ();
+          bytes += sz;
+        }
+      while (sz > 0 && bytes < m_quantum);
+
+      if (bytes == 0)
+        {
+          continue; // Queue emptied (e.g., by RTO), flow goes idle
+        }
+
+      // Next send once released bytes drained at pacing rate (in Mb/s)
+      double pacing_rate = socket->GetPacingRate ();
+      socket->m_pacing_next = now;
+      if (pacing_rate > 0)
+        {
+          socket->m_pacing_next += Seconds (bytes * 8 / (pacing_rate * 1000000));
+        }
+      NS_LOG_LOGIC (this << " " << socket << " released " << bytes <<
+                    " bytes, rate " << pacing_rate << " next " <<
+                    socket->m_pacing_next.GetSeconds ());
+
+      if (!socket->m_pacing_packets.empty ())
+        {
+          Insert (socket, socket->m_pacing_next);
+        }
+    }
+
+  // Dormant until a socket queues a packet, if no flow is left
+  if (!m_flows.empty ())
+    {
+      m_eventTime = m_flows.begin ()->first;
+      m_event = Simulator::Schedule (m_eventTime - now,
+                                     &TcpPacingScheduler::Release, this);
+    }
+}
+
+} // namespace ns3
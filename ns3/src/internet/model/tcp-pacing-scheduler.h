@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef TCP_PACING_SCHEDULER_H
+#define TCP_PACING_SCHEDULER_H
+
+#include <map>
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+
+namespace ns3 {
+
+class Node;
+class TcpSocketBase;
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Per-node scheduler releasing the paced packets of all TCP sockets
+ *
+ * Like the Linux fq qdisc, paced sockets (flows) with packets waiting are
+ * kept in a queue ordered by the time their next packet may leave, and a
+ * single timer, set for the earliest of them, releases packets for every
+ * flow on the node. After a release, a flow may next send once the bytes
+ * released have drained at its pacing rate. With no packets waiting the
+ * timer is not set at all.
+ *
+ * One scheduler is aggregated to each node, on first use (see GetScheduler).
+ */
+class TcpPacingScheduler : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpPacingScheduler ();
+  virtual ~TcpPacingScheduler ();
+
+  /**
+   * \brief Get the scheduler of a node, aggregating one if it has none
+   *
+   * \param node the node
+   * \return the scheduler of the node
+   */
+  static Ptr<TcpPacingScheduler> GetScheduler (Ptr<Node> node);
+
+  /**
+   * \brief Schedule a socket that has packets waiting to be paced
+   *
+   * Has no effect if the socket is already scheduled.
+   *
+   * \param socket the socket
+   */
+  void Enqueue (Ptr<TcpSocketBase> socket);
+
+  /**
+   * \brief Stop releasing packets for a socket (e.g., on close)
+   *
+   * Takes a plain pointer, so that it can be called from the socket
+   * destructor.
+   *
+   * \param socket the socket
+   */
+  void Remove (TcpSocketBase *socket);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  typedef std::multimap<Time, Ptr<TcpSocketBase> > FlowQueue; //!< Flows by next send time
+
+  /**
+   * \brief Add a socket to the flow queue
+   *
+   * \param socket the socket
+   * \param time time its next packet may leave
+   */
+  void Insert (Ptr<TcpSocketBase> socket, Time time);
+
+  /**
+   * \brief Release packets of all flows due, then set timer for the next one
+   */
+  void Release (void);
+
+  FlowQueue m_flows;                      //!< Scheduled flows, by next send time
+  std::map<TcpSocketBase *, FlowQueue::iterator> m_scheduled; //!< Position of each scheduled flow
+  EventId   m_event;                      //!< Timer for the earliest flow
+  Time      m_eventTime;                  //!< Time the timer expires
+  uint32_t  m_quantum;                    //!< Bytes released per flow at a time
+  Time      m_timerSlack;                 //!< Flows due within this are released together
+};
+
+} // namespace ns3
+
+#endif /* TCP_PACING_SCHEDULER_H */
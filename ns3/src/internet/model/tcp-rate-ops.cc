@@ -0,0 +1,325 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "tcp-rate-ops.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpRateOps");
+NS_OBJECT_ENSURE_REGISTERED (TcpRateOps);
+
+TypeId
+TcpRateOps::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRateOps")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+  ;
+  return tid;
+}
+
+TcpRateOps::TcpRateSample::TcpRateSample ()
+  : m_deliveryRate (0),
+    m_isAppLimited (false),
+    m_isRetrans (false),
+    m_interval (Seconds (0)),
+    m_delivered (-1),
+    m_priorDelivered (0),
+    m_priorTime (Seconds (0)),
+    m_sendElapsed (Seconds (0)),
+    m_ackElapsed (Seconds (0)),
+    m_ackedSacked (0)
+{
+}
+
+TcpRateOps::TcpRateConnection::TcpRateConnection ()
+  : m_delivered (0),
+    m_deliveredTime (Seconds (0)),
+    m_firstSentTime (Seconds (0)),
+    m_appLimited (0),
+    m_rateDelivered (0),
+    m_rateAppLimited (false)
+{
+}
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRateLinux);
+
+TypeId
+TcpRateLinux::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRateLinux")
+    .SetParent<TcpRateOps> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpRateLinux> ()
+    .AddTraceSource ("SegmentsBytes",
+                     "Bytes allocated for the delivery state of segments",
+                     MakeTraceSourceAccessor (&TcpRateLinux::m_segmentsBytes),
+                     "ns3::TracedValueCallback::Uint32")
+  ;
+  return tid;
+}
+
+TcpRateLinux::TcpRateLinux ()
+  : TcpRateOps (),
+    m_segmentsBytes (0),
+    m_hasPrior (false)
+{
+}
+
+size_t
+TcpRateLinux::LowerBound (SequenceNumber32 seq) const
+{
+  size_t first = 0;
+  size_t last = m_segments.size ();
+  while (first < last)
+    {
+      size_t middle = first + (last - first) / 2;
+      if (m_segments[middle].m_seq < seq)
+        {
+          first = middle + 1;
+        }
+      else
+        {
+          last = middle;
+        }
+    }
+  return first;
+}
+
+size_t
+TcpRateLinux::UpperBound (SequenceNumber32 seq) const
+{
+  size_t first = 0;
+  size_t last = m_segments.size ();
+  while (first < last)
+    {
+      size_t middle = first + (last - first) / 2;
+      if (m_segments[middle].m_seq + m_segments[middle].m_size <= seq)
+        {
+          first = middle + 1;
+        }
+      else
+        {
+          last = middle;
+        }
+    }
+  return first;
+}
+
+void
+TcpRateLinux::Stamp (TcpRateSegment &segment)
+{
+  segment.m_delivered = m_rate.m_delivered;
+  segment.m_deliveredTime = m_rate.m_deliveredTime;
+  segment.m_firstSentTime = m_rate.m_firstSentTime;
+  segment.m_sentTime = Simulator::Now ();
+  segment.m_isAppLimited = (m_rate.m_appLimited != 0);
+}
+
+void
+TcpRateLinux::SkbSent (SequenceNumber32 seq, uint32_t size,
+                       bool isStartOfTransmission)
+{
+  NS_LOG_FUNCTION (this << seq << size << isStartOfTransmission);
+
+  if (size == 0)
+    {
+      return; // Nothing to deliver (e.g., bare FIN)
+    }
+
+  if (isStartOfTransmission)
+    {
+      // Nothing in flight: start the send and ACK phases of the next
+      // interval now, so an idle period is not counted in it
+      m_rate.m_firstSentTime = Simulator::Now ();
+      m_rate.m_deliveredTime = Simulator::Now ();
+    }
+
+  if (m_segments.empty ()
+      || seq >= m_segments.back ().m_seq + m_segments.back ().m_size)
+    {
+      TcpRateSegment segment;
+      segment.m_seq = seq;
+      segment.m_size = size;
+      segment.m_isRetrans = false;
+      segment.m_sacked = false;
+      Stamp (segment);
+      m_segments.push_back (segment);
+      m_segmentsBytes = m_segments.capacity () * sizeof (TcpRateSegment);
+      return;
+    }
+
+  // Retransmission: restamp every segment it overlaps. Segments are
+  // ordered and do not overlap, so the first one ending after seq is found
+  // by binary search.
+  for (size_t i = UpperBound (seq);
+       i < m_segments.size () && m_segments[i].m_seq < seq + size; i++)
+    {
+      TcpRateSegment &segment = m_segments[i];
+      if (!segment.m_sacked)
+        {
+          segment.m_isRetrans = true;
+          Stamp (segment);
+        }
+    }
+}
+
+void
+TcpRateLinux::SkbDelivered (const TcpRateSegment &segment)
+{
+  m_rate.m_delivered += segment.m_size;
+  m_rateSample.m_ackedSacked += segment.m_size;
+
+  // The sample is taken from the most recently sent segment delivered
+  if (!m_hasPrior || segment.m_delivered > m_rateSample.m_priorDelivered)
+    {
+      m_hasPrior = true;
+      m_rateSample.m_priorDelivered = segment.m_delivered;
+      m_rateSample.m_priorTime = segment.m_deliveredTime;
+      m_rateSample.m_isAppLimited = segment.m_isAppLimited;
+      m_rateSample.m_isRetrans = segment.m_isRetrans;
+      m_rateSample.m_sendElapsed = segment.m_sentTime - segment.m_firstSentTime;
+      m_rate.m_firstSentTime = segment.m_sentTime;
+    }
+}
+
+void
+TcpRateLinux::SkbSacked (const TcpOptionSack::SackList &list)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (TcpOptionSack::SackList::const_iterator block = list.begin ();
+       block != list.end (); ++block)
+    {
+      for (size_t i = LowerBound (block->first); i < m_segments.size ()
+           && m_segments[i].m_seq + m_segments[i].m_size <= block->second; i++)
+        {
+          TcpRateSegment &segment = m_segments[i];
+          if (!segment.m_sacked)
+            {
+              SkbDelivered (segment);
+              segment.m_sacked = true;
+            }
+        }
+    }
+}
+
+void
+TcpRateLinux::SkbAcked (SequenceNumber32 ackNumber)
+{
+  NS_LOG_FUNCTION (this << ackNumber);
+
+  while (!m_segments.empty ()
+         && m_segments.front ().m_seq + m_segments.front ().m_size <= ackNumber)
+    {
+      if (!m_segments.front ().m_sacked)
+        {
+          SkbDelivered (m_segments.front ());
+        }
+      m_segments.pop_front ();
+    }
+}
+
+void
+TcpRateLinux::CalculateAppLimited (uint32_t cWnd, uint32_t inFlight,
+                                   uint32_t segmentSize,
+                                   uint32_t pendingBytes)
+{
+  NS_LOG_FUNCTION (this << cWnd << inFlight << segmentSize << pendingBytes);
+
+  // Less than a segment to send and room in the window: the application
+  // is the limit, until what is in flight now has been delivered
+  if (pendingBytes < segmentSize && inFlight < cWnd)
+    {
+      m_rate.m_appLimited = std::max<uint64_t> (m_rate.m_delivered + inFlight, 1);
+    }
+}
+
+const TcpRateOps::TcpRateSample &
+TcpRateLinux::GenerateSample (const Time &minRtt)
+{
+  NS_LOG_FUNCTION (this << minRtt);
+
+  // Start the next sample from scratch, whatever happens to this one
+  m_lastSample = m_rateSample;
+  m_rateSample = TcpRateSample ();
+  bool hasPrior = m_hasPrior;
+  m_hasPrior = false;
+
+  if (m_rate.m_appLimited != 0 && m_rate.m_delivered > m_rate.m_appLimited)
+    {
+      m_rate.m_appLimited = 0;
+    }
+
+  if (m_lastSample.m_ackedSacked > 0)
+    {
+      m_rate.m_deliveredTime = Simulator::Now ();
+    }
+
+  if (!hasPrior)
+    {
+      m_lastSample.m_delivered = -1;
+      m_lastSample.m_interval = Seconds (0);
+      return m_lastSample;
+    }
+
+  m_lastSample.m_delivered = m_rate.m_delivered - m_lastSample.m_priorDelivered;
+  m_lastSample.m_ackElapsed = Simulator::Now () - m_lastSample.m_priorTime;
+
+  // Use the longer of the send and ACK phases, so that neither ACK
+  // compression nor a burst of sends inflates the rate
+  m_lastSample.m_interval = std::max (m_lastSample.m_sendElapsed,
+                                      m_lastSample.m_ackElapsed);
+
+  // An interval shorter than min RTT can only come from a bad measurement
+  // (e.g., stretched ACKs or a spurious retransmission)
+  if (m_lastSample.m_interval < minRtt)
+    {
+      NS_LOG_LOGIC ("Interval " << m_lastSample.m_interval
+                    << " shorter than min RTT " << minRtt);
+      m_lastSample.m_interval = Seconds (0);
+      return m_lastSample;
+    }
+
+  m_lastSample.m_deliveryRate =
+    DataRate (static_cast<uint64_t> (m_lastSample.m_delivered * 8.0
+                                     / m_lastSample.m_interval.GetSeconds ()));
+
+  // Keep the last non-app-limited rate, or the highest app-limited one
+  if (!m_lastSample.m_isAppLimited
+      || m_lastSample.m_deliveryRate >= m_rate.m_rateDelivered)
+    {
+      m_rate.m_rateDelivered = m_lastSample.m_deliveryRate;
+      m_rate.m_rateAppLimited = m_lastSample.m_isAppLimited;
+    }
+
+  NS_LOG_LOGIC ("Delivered " << m_lastSample.m_delivered << " bytes in "
+                << m_lastSample.m_interval << ", rate "
+                << m_lastSample.m_deliveryRate);
+  return m_lastSample;
+}
+
+const TcpRateOps::TcpRateConnection &
+TcpRateLinux::GetConnectionRate (void) const
+{
+  return m_rate;
+}
+
+} // namespace ns3
@@ -0,0 +1,220 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef TCP_RATE_OPS_H
+#define TCP_RATE_OPS_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-value.h"
+#include "ns3/data-rate.h"
+#include "ns3/sequence-number.h"
+#include "ns3/tcp-option-sack.h"
+#include "ns3/tcp-bbr-window.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Interface for delivery rate estimation
+ *
+ * The socket tells the estimator about every (re)transmitted segment and
+ * every ACK; on each ACK the estimator generates a rate sample, which the
+ * socket passes to the congestion control (TcpCongestionOps::CongControl).
+ */
+class TcpRateOps : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Rate sample generated on each ACK (Linux struct rate_sample)
+   *
+   * The sample is invalid (e.g., no segment sent after the estimator had a
+   * delivery time to compare against was delivered by the ACK) if
+   * m_delivered is negative or m_interval is not strictly positive.
+   */
+  struct TcpRateSample
+  {
+    TcpRateSample ();
+
+    DataRate m_deliveryRate;   //!< Delivery rate over m_interval
+    bool     m_isAppLimited;   //!< Sample taken while application-limited
+    bool     m_isRetrans;      //!< Sample is from a retransmitted segment
+    Time     m_interval;       //!< Length of the sampling interval
+    int64_t  m_delivered;      //!< Bytes delivered over m_interval
+    uint64_t m_priorDelivered; //!< Connection m_delivered when segment was sent
+    Time     m_priorTime;      //!< Connection m_deliveredTime when segment was sent
+    Time     m_sendElapsed;    //!< Send phase of the interval
+    Time     m_ackElapsed;     //!< ACK phase of the interval
+    uint32_t m_ackedSacked;    //!< Bytes newly ACKed or SACKed by this ACK
+  };
+
+  /**
+   * \brief Connection delivery state (Linux struct tcp_sock rate fields)
+   */
+  struct TcpRateConnection
+  {
+    TcpRateConnection ();
+
+    uint64_t m_delivered;      //!< Total bytes delivered (ACKed or SACKed)
+    Time     m_deliveredTime;  //!< Time m_delivered was last updated
+    Time     m_firstSentTime;  //!< Send time of the segment starting the interval
+    uint64_t m_appLimited;     //!< m_delivered at which app-limited ends, 0 if not
+    DataRate m_rateDelivered;  //!< Last non-app-limited (or highest) rate
+    bool     m_rateAppLimited; //!< m_rateDelivered was app-limited
+  };
+
+  /**
+   * \brief Stamp a segment with the connection delivery state on transmit
+   *
+   * \param seq first sequence number of the segment
+   * \param size size of the segment (bytes)
+   * \param isStartOfTransmission true if nothing was in flight before it
+   */
+  virtual void SkbSent (SequenceNumber32 seq, uint32_t size,
+                        bool isStartOfTransmission) = 0;
+
+  /**
+   * \brief Deliver the segments covered by SACK blocks of an ACK
+   *
+   * \param list SACK blocks of the ACK
+   */
+  virtual void SkbSacked (const TcpOptionSack::SackList &list) = 0;
+
+  /**
+   * \brief Deliver the segments cumulatively acknowledged by an ACK
+   *
+   * \param ackNumber cumulative ACK number
+   */
+  virtual void SkbAcked (SequenceNumber32 ackNumber) = 0;
+
+  /**
+   * \brief Mark the connection app-limited if the application, not the
+   * congestion window, is what limits sending
+   *
+   * \param cWnd congestion window (bytes)
+   * \param inFlight bytes in flight
+   * \param segmentSize segment size (bytes)
+   * \param pendingBytes bytes written by the application but not yet sent
+   */
+  virtual void CalculateAppLimited (uint32_t cWnd, uint32_t inFlight,
+                                    uint32_t segmentSize,
+                                    uint32_t pendingBytes) = 0;
+
+  /**
+   * \brief Generate the rate sample for the ACK just processed
+   *
+   * \param minRtt minimum RTT of the connection; shorter intervals are
+   * not valid samples
+   * \return the rate sample
+   */
+  virtual const TcpRateSample & GenerateSample (const Time &minRtt) = 0;
+
+  /**
+   * \return the connection delivery state
+   */
+  virtual const TcpRateConnection & GetConnectionRate (void) const = 0;
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Delivery rate estimation as in Linux tcp_rate.c
+ *
+ * See draft-cheng-iccrg-delivery-rate-estimation. The delivery state
+ * stamped on each segment is kept here, ordered by sequence number,
+ * rather than in the Tx buffer items. It is kept in a ring that only
+ * grows, so once it holds a full window no ACK or transmission allocates.
+ */
+class TcpRateLinux : public TcpRateOps
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpRateLinux ();
+
+  virtual void SkbSent (SequenceNumber32 seq, uint32_t size,
+                        bool isStartOfTransmission);
+  virtual void SkbSacked (const TcpOptionSack::SackList &list);
+  virtual void SkbAcked (SequenceNumber32 ackNumber);
+  virtual void CalculateAppLimited (uint32_t cWnd, uint32_t inFlight,
+                                    uint32_t segmentSize,
+                                    uint32_t pendingBytes);
+  virtual const TcpRateSample & GenerateSample (const Time &minRtt);
+  virtual const TcpRateConnection & GetConnectionRate (void) const;
+
+private:
+  /**
+   * \brief Delivery state stamped on a segment when (re)transmitted
+   */
+  struct TcpRateSegment
+  {
+    SequenceNumber32 m_seq;           //!< First sequence number
+    uint32_t         m_size;          //!< Size (bytes)
+    uint64_t         m_delivered;     //!< Connection m_delivered at send
+    Time             m_deliveredTime; //!< Connection m_deliveredTime at send
+    Time             m_firstSentTime; //!< Connection m_firstSentTime at send
+    Time             m_sentTime;      //!< Time of (last) transmission
+    bool             m_isAppLimited;  //!< Connection app-limited at send
+    bool             m_isRetrans;     //!< Segment was retransmitted
+    bool             m_sacked;        //!< Already delivered by a SACK
+  };
+
+  /**
+   * \brief Stamp segment with current connection delivery state
+   * \param segment segment to stamp
+   */
+  void Stamp (TcpRateSegment &segment);
+
+  /**
+   * \brief Account for a delivered segment in the sample being built
+   * \param segment delivered segment
+   */
+  void SkbDelivered (const TcpRateSegment &segment);
+
+  /**
+   * \param seq sequence number
+   * \return index of the first segment starting at or after seq
+   */
+  size_t LowerBound (SequenceNumber32 seq) const;
+
+  /**
+   * \param seq sequence number
+   * \return index of the first segment ending after seq
+   */
+  size_t UpperBound (SequenceNumber32 seq) const;
+
+  bbr::RingBuffer<TcpRateSegment> m_segments; //!< Segments in flight, by sequence
+  TracedValue<uint32_t> m_segmentsBytes; //!< Bytes allocated for m_segments
+  TcpRateConnection m_rate;              //!< Connection delivery state
+  TcpRateSample     m_rateSample;        //!< Sample being built for this ACK
+  TcpRateSample     m_lastSample;        //!< Last sample generated
+  bool              m_hasPrior;          //!< A segment was delivered by this ACK
+};
+
+} // namespace ns3
+
+#endif /* TCP_RATE_OPS_H */
@@ -39,6 +39,7 @@
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/enum.h"
 #include "ns3/pointer.h"
 #include "ns3/trace-source-accessor.h"
 #include "tcp-socket-base.h"
@@ -127,6 +128,14 @@ TcpSocketBase::GetTypeId (void)
                    PointerValue (),
                    MakePointerAccessor (&TcpSocketBase::GetRxBuffer),
                    MakePointerChecker<TcpRxBuffer> ())
+    .AddAttribute ("PacingMode",
+                   "Where packets are paced: in TCP, in the application, or not at all",
+                   EnumValue (TCP_PACING),
+                   MakeEnumAccessor (&TcpSocketBase::SetPacingMode,
+                                     &TcpSocketBase::GetPacingMode),
+                   MakeEnumChecker (TCP_PACING, "TcpPacing",
+                                    APP_PACING, "AppPacing",
+                                    NO_PACING, "NoPacing"))
     .AddAttribute ("ReTxThreshold", "Threshold for fast retransmit",
                    UintegerValue (3),
                    MakeUintegerAccessor (&TcpSocketBase::m_retxThresh),
@@ -171,6 +180,10 @@ TcpSocketBase::GetTypeId (void)
                      "Socket estimation of bytes in flight",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_bytesInFlight),
                      "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("PacingQueueBytes",
+                     "Bytes queued for pacing, counted in flight but not yet sent",
+                     MakeTraceSourceAccessor (&TcpSocketBase::m_pacing_bytes),
+                     "ns3::TracedValueCallback::Uint32")
     .AddTraceSource ("HighestRxSequence",
                      "Highest sequence number received from peer",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_highRxMark),
@@ -251,7 +264,10 @@ TcpSocketState::TcpSocketState (void)
     m_nextTxSequence (0),
     m_rcvTimestampValue (0),
     m_rcvTimestampEchoReply (0),
-    m_pacing_rate (0.0) // For pacing
+    m_minRtt (Time::Max ()),
+    m_rttSample (Seconds (0)),
+    m_pacing_rate (0.0), // For pacing
+    m_pacing_mode (TCP_PACING) // For pacing
 {
 }
 
@@ -268,7 +284,10 @@ TcpSocketState::TcpSocketState (const TcpSocketState &other)
     m_nextTxSequence (other.m_nextTxSequence),
     m_rcvTimestampValue (other.m_rcvTimestampValue),
     m_rcvTimestampEchoReply (other.m_rcvTimestampEchoReply),
-    m_pacing_rate (other.m_pacing_rate) // For pacing
+    m_minRtt (other.m_minRtt),
+    m_rttSample (other.m_rttSample),
+    m_pacing_rate (other.m_pacing_rate), // For pacing
+    m_pacing_mode (other.m_pacing_mode)  // For pacing
 {
 }
 
@@ -280,8 +299,10 @@ TcpSocketState::TcpCongStateName[TcpSocketState::CA_LAST_STATE] =
 
 TcpSocketBase::TcpSocketBase (void)
   : TcpSocket (),
-    m_pacing_event (),   // For pacing
-    m_pacing_packets (), // For pacing
+    m_pacing_packets (),    // For pacing
+    m_pacing_bytes (0),     // For pacing
+    m_pacing_scheduler (0), // For pacing
+    m_pacing_next (Seconds (0.0)), // For pacing
     m_retxEvent (),
     m_lastAckEvent (),
     m_delAckEvent (),
@@ -340,14 +361,10 @@ TcpSocketBase::TcpSocketBase (void)
 {
   NS_LOG_FUNCTION (this);
 
-  if (PACING_CONFIG == TCP_PACING) 
-    NS_LOG_INFO ("PACING_IN_TCP - Pacing in TCP is enabled.");
-  else
-    NS_LOG_INFO ("APP_PACING/NO_PACING - Pacing in TCP is *not* enabled.");
-
   m_rxBuffer = CreateObject<TcpRxBuffer> ();
   m_txBuffer = CreateObject<TcpTxBuffer> ();
   m_tcb      = CreateObject<TcpSocketState> ();
+  m_rateOps  = CreateObject<TcpRateLinux> ();
 
   bool ok;
 
@@ -374,8 +391,10 @@ TcpSocketBase::TcpSocketBase (void)
 
 TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
   : TcpSocket (sock),
-    m_pacing_event (sock.m_pacing_event),     // For pacing
     m_pacing_packets (sock.m_pacing_packets), // For pacing
+    m_pacing_bytes (sock.m_pacing_bytes),     // For pacing
+    m_pacing_scheduler (0),                   // For pacing
+    m_pacing_next (sock.m_pacing_next),       // For pacing
     //copy object::m_tid and socket::callbacks
     m_dupAckCount (sock.m_dupAckCount),
     m_delAckCount (0),
@@ -441,6 +460,7 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
   m_txBuffer = CopyObject (sock.m_txBuffer);
   m_rxBuffer = CopyObject (sock.m_rxBuffer);
   m_tcb = CopyObject (sock.m_tcb);
+  m_rateOps = CreateObject<TcpRateLinux> ();
   if (sock.m_congestionControl)
     {
       m_congestionControl = sock.m_congestionControl->Fork ();
@@ -1663,6 +1683,12 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
   // are inside the function ProcessAck
   ProcessAck (ackNumber, scoreboardUpdated);
 
+  // Segments SACKed were delivered in ReadOptions, add those cumulatively
+  // ACKed, then give congestion control the rate sample of this ACK
+  m_rateOps->SkbAcked (ackNumber);
+  m_congestionControl->CongControl (m_tcb, m_rateOps->GetConnectionRate (),
+                                    m_rateOps->GenerateSample (m_tcb->m_minRtt));
+
   // RFC 6675, Section 5, point (C), try to send more data. NB: (C) is implemented
   // inside SendPendingData
   SendPendingData (m_connected);
@@ -2666,93 +2692,79 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
 {
   NS_LOG_FUNCTION (this << seq << maxSize << withAck);
 
-  // If not TCP pacing, go ahead and send normally.
-  if (PACING_CONFIG == NO_PACING || PACING_CONFIG == APP_PACING)
+  // If not TCP pacing, go ahead and send normally
+  // (unless packets still queued from before mode changed).
+  if (m_tcb->GetPacingMode() != TCP_PACING && m_pacing_packets.empty())
     return SendDataPacketReal(seq, maxSize, withAck);
 
   // Pacing, so queue until time to send else send now.
   // pacing_rate: pacing rate for flow, controls inter-packet spacing.
+  // If rate is 0, still queue behind any packets waiting (not reorder).
   double pacing_rate = m_tcb -> GetPacingRate();
-  if (pacing_rate == 0.0) {
+  if (pacing_rate == 0.0 && m_pacing_packets.empty()) {
     NS_LOG_LOGIC (this << " Pacing rate is 0");
     return SendDataPacketReal(seq, maxSize, withAck);
   } else {
     NS_LOG_LOGIC (this << " Pacing rate: " << pacing_rate);
 
+    // Extract data once, sent as is when released.
+    Ptr<Packet> p = m_txBuffer->CopyFromSequence(maxSize, seq);
+    uint32_t sz = p->GetSize(); // Size of packet
+
     // Store packet.
-    tcp_pacing_struct packet{seq, maxSize, withAck};
+    tcp_pacing_struct packet{seq, maxSize, withAck, p};
     m_pacing_packets.push(packet);
+    m_pacing_bytes += sz;
 
     NS_LOG_LOGIC (this << " Storing: " <<
                  packet.seq << " " << 
                  packet.maxSize << " " <<
-                 packet.withAck);
+                 packet.withAck << " " <<
+                 sz);
                  
-    // If no pending event, immediately schedule.
-    if (m_pacing_event.IsExpired()) {
-      m_pacing_event = Simulator::ScheduleNow(&TcpSocketBase::PacePackets, this);
-      NS_LOG_LOGIC (this << " Previous event expired. Scheduling immediately. event_id: " << m_pacing_event.GetUid() << "  timestamp: " << m_pacing_event.GetTs()/1000000000.0);
-    }
+    // Node's pacing scheduler releases it (one timer for all sockets).
+    if (m_pacing_scheduler == 0)
+      m_pacing_scheduler = TcpPacingScheduler::GetScheduler(m_node);
+    m_pacing_scheduler->Enqueue(this);
 
-    // Return size that would have been sent so app knows it's scheduled.
-    Ptr<Packet> p = m_txBuffer->CopyFromSequence(maxSize, seq);
-    uint32_t sz = p->GetSize(); // Size of packet
     return sz;
   }
 }
 
-// Send next packet in queue and set timer for subsequent send.
-void TcpSocketBase::PacePackets () {
-  double size;
+// Send next packet in queue (called by pacing scheduler).
+// Return size sent, 0 if queue empty.
+uint32_t TcpSocketBase::SendPacedPacket () {
   NS_LOG_FUNCTION (this);
 
   // If pacing queue empty, app hasn't provided more data.
   NS_LOG_INFO (this << " Pacing packets: " << m_pacing_packets.size());
   if (m_pacing_packets.empty()) {
     NS_LOG_LOGIC (this << " Pacing list empty.");
-    size = 1000; // Temporary packet bytes for computing pacing interval.
-  } else {
-
-    // Get next packet to send.
-    tcp_pacing_struct packet = m_pacing_packets.front();
-    m_pacing_packets.pop();
-
-    NS_LOG_LOGIC (this << " Sending real: " <<
-                 packet.seq << " " << 
-                 packet.maxSize << " " <<
-                 packet.withAck);
+    return 0;
+  }
 
-    // Send it.
-    SendDataPacketReal(packet.seq, packet.maxSize, packet.withAck);
+  // Get next packet to send.
+  tcp_pacing_struct packet = m_pacing_packets.front();
+  m_pacing_packets.pop();
+  m_pacing_bytes -= packet.packet->GetSize();
 
-    // Get size for computing pacing interval.
-    size = packet.maxSize;
-  }
+  NS_LOG_LOGIC (this << " Sending real: " <<
+               packet.seq << " " << 
+               packet.maxSize << " " <<
+               packet.withAck);
 
-  // Schedule next send event.
-  double pacing_rate = m_tcb -> GetPacingRate();
-  if (pacing_rate > 0) {
-    size *= 8 / 1000000.0;  // Convert to Mbits.
-    double delta = size / pacing_rate; // Convert to seconds.
-    delta *= 1000000000;  // Convert to nanoseconds.
-    m_pacing_event.Cancel();  // Cancel any pending events. Needed?
-    m_pacing_event = Simulator::Schedule(Time(delta),
-                                         &TcpSocketBase::PacePackets, this);
-    NS_LOG_LOGIC (this <<
-                 " event_id: " << m_pacing_event.GetUid() <<
-                 "  size: " << size/8*1000000 <<
-                 "  rate: " << pacing_rate <<
-                 "  delta: " << delta/1000000000 <<
-                 "  @time: " << Time(Simulator::Now()+delta).GetSeconds());
-  } else
-    NS_LOG_LOGIC (this << " rate: " << pacing_rate << " (no pacing)");  
+  // Send it.
+  return SendDataPacketReal(packet.seq, packet.maxSize, packet.withAck,
+                            packet.packet);
 }
   
 /* Really send the data packet.
-   Extract at most maxSize bytes from the TxBuffer at sequence seq, add the
-   TCP header, and send to TcpL4Protocol */
+   Extract at most maxSize bytes from the TxBuffer at sequence seq (unless
+   already extracted when paced), add the TCP header, and send to
+   TcpL4Protocol */
 uint32_t
-TcpSocketBase::SendDataPacketReal (SequenceNumber32 seq, uint32_t maxSize, bool withAck)
+TcpSocketBase::SendDataPacketReal (SequenceNumber32 seq, uint32_t maxSize, bool withAck,
+                                   Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << seq << maxSize << withAck);
 
@@ -2768,11 +2780,18 @@ TcpSocketBase::SendDataPacketReal (SequenceNumber32 seq, uint32_t maxSize, bool
   m_congestionControl->Send(this, m_tcb, seq, isRetransmission); 
   ////////////////////////////////////////////////////////
 
-  Ptr<Packet> p = m_txBuffer->CopyFromSequence (maxSize, seq);
+  if (p == 0)
+    {
+      p = m_txBuffer->CopyFromSequence (maxSize, seq);
+    }
   uint32_t sz = p->GetSize (); // Size of packet
   uint8_t flags = withAck ? TcpHeader::ACK : 0;
   uint32_t remainingData = m_txBuffer->SizeFromSequence (seq + SequenceNumber32 (sz));
 
+  // Stamp the segment with the delivery state, for rate sampling when it
+  // is ACKed or SACKed
+  m_rateOps->SkbSent (seq, sz, UnAckDataCount () == 0);
+
   if (withAck)
     {
       m_delAckEvent.Cancel ();
@@ -3028,6 +3047,15 @@ TcpSocketBase::SendPendingData (bool withAck)
       // loop again!
     }
 
+  // With nothing waiting to be paced out, less than a segment left to send
+  // and room in cwnd, the application limits the delivery rate
+  if (m_pacing_packets.empty ())
+    {
+      m_rateOps->CalculateAppLimited (m_tcb->m_cWnd, BytesInFlight (),
+                                      m_tcb->m_segmentSize,
+                                      m_txBuffer->SizeFromSequence (m_tcb->m_nextTxSequence));
+    }
+
   if (nPacketsSent > 0)
     {
       NS_LOG_DEBUG ("SendPendingData sent " << nPacketsSent << " segments");
@@ -3093,7 +3121,7 @@ TcpSocketBase::BytesInFlight () const
   NS_LOG_DEBUG ("Returning calculated bytesInFlight: " << bytesInFlight);
 
   // Compute adjusted queue: inflight - pacing queue
-  auto pacing_bytes = pacingQueueBytes();
+  uint32_t pacing_bytes = m_pacing_bytes;
   int adj_bytes = bytesInFlight - pacing_bytes;
 
   NS_LOG_INFO(this <<
@@ -3273,12 +3301,16 @@ TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
       m_history.pop_front (); // Remove
     }
 
+  // m_lastRtt is smoothed and kept across ACKs; congestion controls that
+  // need the delay of this ACK itself (e.g., HyStart++) read m_rttSample.
+  m_tcb->m_rttSample = m;
   if (!m.IsZero ())
     {
       m_rtt->Measurement (m);                // Log the measurement
       // RFC 6298, clause 2.4
       m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
       m_lastRtt = m_rtt->GetEstimate ();
+      m_tcb->m_minRtt = std::min (m_tcb->m_minRtt, m);
       NS_LOG_FUNCTION (this << m_lastRtt);
     }
 }
@@ -3412,8 +3444,8 @@ TcpSocketBase::ReTxTimeout ()
   // Clear any remaining packets in pacing queue.
   NS_LOG_DEBUG("RTO. Clearing pacing queue, packet count: "
                << m_pacing_packets.size());
-  while (!m_pacing_packets.empty())
-    m_pacing_packets.pop();
+  std::queue<tcp_pacing_struct> ().swap(m_pacing_packets);
+  m_pacing_bytes = 0;
   
   NS_LOG_DEBUG ("RTO. Reset cwnd to " <<  m_tcb->m_cWnd << ", ssthresh to " <<
                 m_tcb->m_ssThresh << ", restart from seqnum " <<
@@ -3565,6 +3597,10 @@ TcpSocketBase::CancelAllTimers ()
   m_lastAckEvent.Cancel ();
   m_timewaitEvent.Cancel ();
   m_sendPendingDataEvent.Cancel ();
+  if (m_pacing_scheduler != 0)
+    {
+      m_pacing_scheduler->Remove (this);
+    }
 }
 
 /* Move TCP to Time_Wait state and schedule a transition to Closed state */
@@ -3829,6 +3865,7 @@ TcpSocketBase::ProcessOptionSack (const Ptr<const TcpOption> option)
 
   Ptr<const TcpOptionSack> s = DynamicCast<const TcpOptionSack> (option);
   TcpOptionSack::SackList list = s->GetSackList ();
+  m_rateOps->SkbSacked (list);
   return m_txBuffer->Update (list);
 }
 
@@ -4088,6 +4125,16 @@ void TcpSocketState::SetPacingRate(double pacing_rate) {
   m_pacing_rate = pacing_rate;
 }
 
+// Get pacing mode.
+enum_pacing_config TcpSocketState::GetPacingMode() const {
+  return m_pacing_mode;
+}
+
+// Set pacing mode.
+void TcpSocketState::SetPacingMode(enum_pacing_config pacing_mode) {
+  m_pacing_mode = pacing_mode;
+}
+
 // Get pacing rate (in tcp socket state).
 double TcpSocketBase::GetPacingRate() const {
   NS_LOG_FUNCTION (this);
@@ -4099,17 +4146,25 @@ void TcpSocketBase::SetPacingRate (double pacing_rate) {
   NS_LOG_FUNCTION (this << pacing_rate);
   m_tcb -> SetPacingRate(pacing_rate);
 }
- 
-// Compute total bytes in pacing packet queue.
+
+// Get pacing mode (in tcp socket state).
+enum_pacing_config TcpSocketBase::GetPacingMode() const {
+  return m_tcb -> GetPacingMode();
+}
+
+// Set pacing mode (in tcp socket state).
+void TcpSocketBase::SetPacingMode (enum_pacing_config pacing_mode) {
+  NS_LOG_FUNCTION (this << pacing_mode);
+  if (pacing_mode == TCP_PACING)
+    NS_LOG_INFO ("TCP_PACING - Pacing in TCP is enabled.");
+  else
+    NS_LOG_INFO ("APP_PACING/NO_PACING - Pacing in TCP is *not* enabled.");
+  m_tcb -> SetPacingMode(pacing_mode);
+}
+
+// Bytes in pacing packet queue (paced but not yet sent).
 int TcpSocketBase::pacingQueueBytes (void) const {
-  int pacing_bytes = 0;
-  std::queue<tcp_pacing_struct> temp_q = m_pacing_packets;
-  while (!temp_q.empty()) {
-    tcp_pacing_struct packet = m_pacing_packets.front();
-    pacing_bytes += packet.maxSize;
-    temp_q.pop();
-  }
-  return pacing_bytes;
+  return m_pacing_bytes;
 }
 
 // ADDITIONS FOR PACING: END
@@ -28,13 +28,9 @@
 // TCP_PACING - Packet pacing is done in TCP (in socket-base.cc).
 // APP_PACING - Packet pacing is NOT done in TCP, only in the application.
 // NO_PACING - No packet pacing is done (BBR' adjusts accordingly).
+// Set per socket with TcpSocketBase attribute "PacingMode".
 enum enum_pacing_config {TCP_PACING, APP_PACING, NO_PACING};
 
-// Actual configuration option.
-const enum_pacing_config PACING_CONFIG = TCP_PACING;
-//const enum_pacing_config PACING_CONFIG = NO_PACING;
-//const enum_pacing_config PACING_CONFIG = APP_PACING;
-
 const float PACING_VERSION = 1.1;  // See changelog.txt.
 
 // ADDITIONS FOR PACING: END
@@ -55,6 +51,8 @@ const float PACING_VERSION = 1.1;  // See changelog.txt.
 #include "tcp-tx-buffer.h"
 #include "tcp-rx-buffer.h"
 #include "rtt-estimator.h"
+#include "tcp-rate-ops.h"
+#include "tcp-pacing-scheduler.h"
 
 namespace ns3 {
 
@@ -186,6 +184,9 @@ public:
   uint32_t               m_rcvTimestampValue;     //!< Receiver Timestamp value 
   uint32_t               m_rcvTimestampEchoReply; //!< Sender Timestamp echoed by the receiver
 
+  Time                   m_minRtt;          //!< Minimum RTT sample of the connection
+  Time                   m_rttSample;       //!< RTT sample of the last ACK, zero if none
+
   /**
    * \brief Get cwnd in segments rather than bytes
    *
@@ -211,8 +212,11 @@ public:
 
   void SetPacingRate (double pacing_rate);
   double GetPacingRate () const;
+  void SetPacingMode (enum_pacing_config pacing_mode);
+  enum_pacing_config GetPacingMode () const;
 protected:
   double            m_pacing_rate;                 // Pacing rate (in Mb/s).
+  enum_pacing_config m_pacing_mode;                // Pacing mode.
 
 };
 
@@ -221,6 +225,7 @@ struct tcp_pacing_struct {
   SequenceNumber32 seq;    // Seq location in TCP buffer.
   uint32_t maxSize;        // Bytes to extract.
   bool withAck;            // Include ack or not.
+  Ptr<Packet> packet;      // Data extracted, sent as is when released.
 };
   
 // ADDITIONS FOR PACING: END
@@ -692,7 +697,9 @@ protected:
    * \returns the number of bytes sent
    */
   uint32_t SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck);
-  uint32_t SendDataPacketReal (SequenceNumber32 seq, uint32_t maxSize, bool withAck);
+  // Send data packet now. If packet given (paced), already extracted from TxBuffer.
+  uint32_t SendDataPacketReal (SequenceNumber32 seq, uint32_t maxSize, bool withAck,
+                               Ptr<Packet> p = 0);
 
   /**
    * \brief Send a empty packet that carries a flag, e.g., ACK
@@ -1117,13 +1124,19 @@ protected:
 public:  
   void SetPacingRate (double pacing_rate);
   double GetPacingRate () const;
+  void SetPacingMode (enum_pacing_config pacing_mode);
+  enum_pacing_config GetPacingMode () const;
   virtual int pacingQueueBytes (void) const;
 
 protected:
-  EventId           m_pacing_event;                // Pacing event.
   std::queue<tcp_pacing_struct> m_pacing_packets;  // Pacing packets.
+  TracedValue<uint32_t> m_pacing_bytes;            // Bytes in pacing packets.
+  Ptr<TcpPacingScheduler> m_pacing_scheduler;      // Node pacing scheduler.
+  Time              m_pacing_next;                 // Earliest next paced send.
 private:
-  void PacePackets();
+  friend class TcpPacingScheduler;
+  // Send next packet in pacing queue, return its size (0 if queue empty).
+  uint32_t SendPacedPacket();
   // ADDITIONS FOR PACING: END
   //////////////////////////////
   
@@ -1204,6 +1217,7 @@ protected:
   // Transmission Control Block
   Ptr<TcpSocketState>    m_tcb;               //!< Congestion control informations
   Ptr<TcpCongestionOps>  m_congestionControl; //!< Congestion control
+  Ptr<TcpRateOps>        m_rateOps;           //!< Delivery rate estimation
 
   // Guesses over the other connection end
   bool m_isFirstPartialAck; //!< First partial ACK during RECOVERY
@@ -0,0 +1,537 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**
+ * Test cases for the TCP BBR' windows.
+ *
+ * Run this test class with
+ * ./test.py -v -s tcp-bbr-test-suite > log.out 2>&1
+ */
+
+#include "ns3/tcp-bbr.h"
+#include "ns3/test.h"
+#include "ns3/core-module.h"
+#include "ns3/log.h"
+using namespace ns3;
+
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+NS_LOG_COMPONENT_DEFINE ("TcpBbrTestSuite");
+
+/*
+ * One BW estimate and RTT sample, as stored by TcpBbr on an ACK.
+ */
+struct BbrAckSample
+{
+  Time time;     // Time of ACK.
+  int round;     // Packet-timed round of ACK.
+  double bw;     // BW estimate (Mb/s).
+  Time rtt;      // RTT sample of ACK.
+  Time minRtt;   // Min RTT at time of ACK.
+};
+
+/*
+ * Generate the BW estimates of a BBR' flow ACK by ACK, shaped like those
+ * recorded from the chapter 6 runs: STARTUP doubling each round, DRAIN,
+ * PROBE_BW gain cycling with noisy estimates, then a drop of the
+ * bottleneck rate so old maxima have to expire from the window. RTT
+ * samples get up to 20% of queueing delay, so old minima expire too.
+ */
+static vector<BbrAckSample>
+MakeAckSequence (double bottleneck, Time baseRtt, int acksPerRound,
+                 int rounds, uint32_t seed)
+{
+  const double gains[] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+  vector<BbrAckSample> acks;
+  uint32_t rand = seed;
+  Time now = Seconds (0);
+  double startup = bottleneck / 64;
+
+  for (int round = 0; round < rounds; round++)
+    {
+      double rate = bottleneck;
+      if (round > rounds / 2)
+        {
+          rate = bottleneck / 3;  // Bottleneck rate drops.
+        }
+      double gain = gains[round % 8];
+      Time rtt = baseRtt;
+      if (startup < rate)
+        {
+          // STARTUP, delivery rate doubles each round.
+          rate = startup;
+          startup *= 2;
+          gain = 1;
+        }
+      else if (gain > 1)
+        {
+          rtt = baseRtt + baseRtt / 4;  // Probing builds a queue.
+        }
+
+      for (int i = 0; i < acksPerRound; i++)
+        {
+          rand = rand * 1103515245 + 12345; // Simple LCG for noise.
+          double noise = 0.9 + 0.2 * ((rand >> 16) % 1000) / 1000.0;
+          rand = rand * 1103515245 + 12345;
+          double queue = 0.2 * ((rand >> 16) % 1000) / 1000.0;
+          now += rtt / acksPerRound;
+          BbrAckSample ack;
+          ack.time = now;
+          ack.round = round;
+          ack.bw = rate * gain * noise;
+          ack.rtt = rtt + NanoSeconds ((int64_t) (rtt.GetNanoSeconds () * queue));
+          ack.minRtt = baseRtt;
+          acks.push_back (ack);
+        }
+    }
+  return acks;
+}
+
+/*
+ * Read the BW estimates of a BBR' flow recorded ACK by ACK. Each line of
+ * the file holds the time of an ACK, its RTT sample and the bytes it
+ * ACKed. The estimate is the bytes ACKed over the last RTT, as a delivery
+ * rate sample, and a round ends with the first ACK one RTT after the
+ * round started.
+ */
+static vector<BbrAckSample>
+ReadAckSequence (const std::string &fileName)
+{
+  vector<BbrAckSample> acks;
+  ifstream in (fileName.c_str ());
+  NS_ABORT_MSG_IF (!in, "Cannot open " << fileName);
+  deque<pair<Time, double> > delivered;  // ACKs of the last RTT.
+  double bytes = 0;
+  Time minRtt = Time::Max ();
+  Time roundEnd = Seconds (0);
+  int round = 0;
+  string line;
+  while (getline (in, line))
+    {
+      istringstream fields (line.substr (0, line.find ('#')));
+      double time, rtt, acked;
+      if (!(fields >> time >> rtt >> acked))
+        {
+          continue;
+        }
+      BbrAckSample ack;
+      ack.time = Seconds (time);
+      minRtt = std::min (minRtt, Seconds (rtt));
+      if (ack.time >= roundEnd)
+        {
+          round++;
+          roundEnd = ack.time + Seconds (rtt);
+        }
+
+      delivered.push_back (make_pair (ack.time, acked));
+      bytes += acked;
+      while (delivered.front ().first <= ack.time - Seconds (rtt))
+        {
+          bytes -= delivered.front ().second;
+          delivered.pop_front ();
+        }
+      ack.round = round;
+      ack.bw = bytes * 8 / rtt / 1000000;
+      ack.rtt = Seconds (rtt);
+      ack.minRtt = minRtt;
+      acks.push_back (ack);
+    }
+  return acks;
+}
+
+/*
+ * Reference BW window, a copy of the BBR' v1.7 linear scan.
+ */
+class BbrReferenceBwWindow
+{
+public:
+  void Add (double bw, Time time, int round)
+  {
+    Sample s;
+    s.bw = bw;
+    s.time = time;
+    s.round = round;
+    m_window.push_back (s);
+  }
+
+  double GetBw (void) const
+  {
+    double max_bw = 0;
+    if (m_window.size () == 0)
+      {
+        return -1.0;
+      }
+    for (auto it = m_window.begin (); it != m_window.end (); it++)
+      {
+        max_bw = std::max (max_bw, it->bw);
+      }
+    return max_bw;
+  }
+
+  void Cull (bbr::enum_time_config config, Time timeDelta, int roundDelta)
+  {
+    auto it = m_window.begin ();
+    while (it != m_window.end ())
+      {
+        if ((config == bbr::WALLCLOCK_TIME && it->time < timeDelta)
+            || (config == bbr::PACKET_TIME && it->round < roundDelta))
+          {
+            it = m_window.erase (it);
+          }
+        else
+          {
+            it++;
+          }
+      }
+  }
+
+private:
+  struct Sample
+  {
+    double bw;
+    Time time;
+    int round;
+  };
+  vector<Sample> m_window;
+};
+
+/*
+ * Reference RTT window, a linear scan like the BBR' v1.7 one. Unlike the
+ * v1.7 map, samples taken at the same time are all kept, as the filter
+ * keeps them.
+ */
+class BbrReferenceRttWindow
+{
+public:
+  void Add (Time rtt, Time time, int round)
+  {
+    Sample s;
+    s.rtt = rtt;
+    s.time = time;
+    s.round = round;
+    m_window.push_back (s);
+  }
+
+  Time GetRtt (void) const
+  {
+    Time min_rtt = Time::Max ();
+    if (m_window.size () == 0)
+      {
+        return Time (-1.0);
+      }
+    for (auto it = m_window.begin (); it != m_window.end (); it++)
+      {
+        min_rtt = std::min (min_rtt, it->rtt);
+      }
+    return min_rtt;
+  }
+
+  void Cull (bbr::enum_time_config config, Time timeDelta, int roundDelta)
+  {
+    auto it = m_window.begin ();
+    while (it != m_window.end ())
+      {
+        if ((config == bbr::WALLCLOCK_TIME && it->time < timeDelta)
+            || (config == bbr::PACKET_TIME && it->round < roundDelta))
+          {
+            it = m_window.erase (it);
+          }
+        else
+          {
+            it++;
+          }
+      }
+  }
+
+private:
+  struct Sample
+  {
+    Time rtt;
+    Time time;
+    int round;
+  };
+  vector<Sample> m_window;
+};
+
+/*
+ * Check that the windowed max BW filter and min RTT filter give the same
+ * max BW and min RTT as the linear scans they replaced, after every ACK
+ * and every cull, for both time configurations, on generated or recorded
+ * ACKs. TcpBbr culls the RTT window only by wallclock time and over
+ * RttWindowTime, but here it is culled like the BW window so that both
+ * ways of expiring samples are checked on short sequences.
+ */
+class TcpBbrFilterTest : public TestCase
+{
+public:
+  TcpBbrFilterTest (bbr::enum_time_config config, double bottleneck,
+                    Time baseRtt, int acksPerRound, int rounds,
+                    uint32_t seed, const std::string &name);
+  TcpBbrFilterTest (bbr::enum_time_config config,
+                    const std::string &ackFile, const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  bbr::enum_time_config m_config;
+  std::string m_ackFile;  // Recorded ACKs in the test directory, or empty.
+  double m_bottleneck;
+  Time m_baseRtt;
+  int m_acksPerRound;
+  int m_rounds;
+  uint32_t m_seed;
+};
+
+TcpBbrFilterTest::TcpBbrFilterTest (bbr::enum_time_config config,
+                                    double bottleneck, Time baseRtt,
+                                    int acksPerRound, int rounds,
+                                    uint32_t seed,
+                                    const std::string &name)
+  : TestCase (name),
+  m_config (config),
+  m_bottleneck (bottleneck),
+  m_baseRtt (baseRtt),
+  m_acksPerRound (acksPerRound),
+  m_rounds (rounds),
+  m_seed (seed)
+{
+}
+
+TcpBbrFilterTest::TcpBbrFilterTest (bbr::enum_time_config config,
+                                    const std::string &ackFile,
+                                    const std::string &name)
+  : TestCase (name),
+  m_config (config),
+  m_ackFile (ackFile),
+  m_bottleneck (0),
+  m_acksPerRound (0),
+  m_rounds (0),
+  m_seed (0)
+{
+}
+
+void
+TcpBbrFilterTest::DoRun (void)
+{
+  vector<BbrAckSample> acks;
+  if (m_ackFile.empty ())
+    {
+      acks = MakeAckSequence (m_bottleneck, m_baseRtt, m_acksPerRound,
+                              m_rounds, m_seed);
+    }
+  else
+    {
+      SetDataDir (NS_TEST_SOURCEDIR);
+      acks = ReadAckSequence (CreateDataDirFilename (m_ackFile));
+      NS_TEST_ASSERT_MSG_EQ (acks.empty (), false, "No ACKs in " << m_ackFile);
+    }
+  BbrReferenceBwWindow reference;
+  bbr::bw_filter filter;
+  BbrReferenceRttWindow rttReference;
+  bbr::rtt_filter rttFilter;
+  int lastRound = 0;
+  size_t maxSize = 0;
+  size_t maxRttSize = 0;
+  size_t roundAcks = 0;
+  size_t maxRoundAcks = 0;
+
+  for (auto it = acks.begin (); it != acks.end (); it++)
+    {
+      // Cull once per round, as BbrStateMachine::update() does.
+      if (it->round != lastRound)
+        {
+          lastRound = it->round;
+          roundAcks = 0;
+          Time timeDelta = it->time - it->minRtt * bbr::BW_WINDOW_TIME;
+          int roundDelta = it->round - bbr::BW_WINDOW_TIME;
+          reference.Cull (m_config, timeDelta, roundDelta);
+          rttReference.Cull (m_config, timeDelta, roundDelta);
+          if (m_config == bbr::WALLCLOCK_TIME)
+            {
+              filter.expireTime (timeDelta);
+              rttFilter.expireTime (timeDelta);
+            }
+          else
+            {
+              filter.expireRound (roundDelta);
+              rttFilter.expireRound (roundDelta);
+            }
+          NS_TEST_ASSERT_MSG_EQ (filter.empty (), reference.GetBw () < 0,
+                                 "Filter empty but reference is not");
+          if (!filter.empty ())
+            {
+              NS_TEST_ASSERT_MSG_EQ (std::max (0.0, filter.getBest ()),
+                                     reference.GetBw (),
+                                     "Max BW differs after cull at "
+                                     << it->time.GetSeconds ());
+            }
+          NS_TEST_ASSERT_MSG_EQ (rttFilter.empty (),
+                                 rttReference.GetRtt ().IsNegative (),
+                                 "RTT filter empty but reference is not");
+          if (!rttFilter.empty ())
+            {
+              NS_TEST_ASSERT_MSG_EQ (rttFilter.getBest (),
+                                     rttReference.GetRtt (),
+                                     "Min RTT differs after cull at "
+                                     << it->time.GetSeconds ());
+            }
+        }
+
+      reference.Add (it->bw, it->time, it->round);
+      filter.update (it->bw, it->time, it->round);
+      rttReference.Add (it->rtt, it->time, it->round);
+      rttFilter.update (it->rtt, it->time, it->round);
+      maxSize = std::max (maxSize, filter.size ());
+      maxRttSize = std::max (maxRttSize, rttFilter.size ());
+      maxRoundAcks = std::max (maxRoundAcks, ++roundAcks);
+
+      NS_TEST_ASSERT_MSG_EQ (std::max (0.0, filter.getBest ()),
+                             reference.GetBw (),
+                             "Max BW differs after ACK at "
+                             << it->time.GetSeconds ());
+      NS_TEST_ASSERT_MSG_EQ (rttFilter.getBest (), rttReference.GetRtt (),
+                             "Min RTT differs after ACK at "
+                             << it->time.GetSeconds ());
+    }
+
+  // Only candidates for max or min are kept, far fewer than one per ACK.
+  NS_TEST_ASSERT_MSG_LT (maxSize, maxRoundAcks * bbr::BW_WINDOW_TIME,
+                         "Filter kept too many samples");
+  NS_TEST_ASSERT_MSG_LT (maxRttSize, maxRoundAcks * bbr::BW_WINDOW_TIME,
+                         "RTT filter kept too many samples");
+}
+
+/*
+ * Check the RttWindowSize and RttWindowBytes trace sources of TcpBbr:
+ * RTT samples that keep growing are all kept, a new minimum drops them
+ * all, and the storage allocated for them is reused.
+ */
+class TcpBbrRttTraceTest : public TestCase
+{
+public:
+  TcpBbrRttTraceTest (const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  void SizeTrace (uint32_t oldValue, uint32_t newValue);
+  void BytesTrace (uint32_t oldValue, uint32_t newValue);
+
+  uint32_t m_size;   // Last RttWindowSize traced.
+  uint32_t m_bytes;  // Last RttWindowBytes traced.
+};
+
+TcpBbrRttTraceTest::TcpBbrRttTraceTest (const std::string &name)
+  : TestCase (name),
+  m_size (0),
+  m_bytes (0)
+{
+}
+
+void
+TcpBbrRttTraceTest::SizeTrace (uint32_t oldValue, uint32_t newValue)
+{
+  m_size = newValue;
+}
+
+void
+TcpBbrRttTraceTest::BytesTrace (uint32_t oldValue, uint32_t newValue)
+{
+  m_bytes = newValue;
+}
+
+void
+TcpBbrRttTraceTest::DoRun (void)
+{
+  Ptr<TcpSocketState> state = CreateObject<TcpSocketState> ();
+  state->m_segmentSize = 1000;
+  state->m_cWnd = 10 * state->m_segmentSize;
+  state->m_congState = TcpSocketState::CA_OPEN;
+
+  Ptr<TcpBbr> cong = CreateObject<TcpBbr> ();
+  cong->TraceConnectWithoutContext ("RttWindowSize",
+    MakeCallback (&TcpBbrRttTraceTest::SizeTrace, this));
+  cong->TraceConnectWithoutContext ("RttWindowBytes",
+    MakeCallback (&TcpBbrRttTraceTest::BytesTrace, this));
+
+  // Each sample is larger than the last, so could still become the min.
+  const uint32_t samples = 5;
+  for (uint32_t i = 0; i < samples; i++)
+    {
+      cong->PktsAcked (state, 1, MilliSeconds (10 + i));
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_size, samples, "Growing RTTs not all kept");
+  NS_TEST_ASSERT_MSG_EQ (m_bytes % sizeof (bbr::rtt_filter::sample), 0,
+                         "Bytes not a whole number of samples");
+  NS_TEST_ASSERT_MSG_EQ (m_bytes >= samples * sizeof (bbr::rtt_filter::sample),
+                         true, "Fewer bytes than samples kept");
+
+  // A new min RTT leaves only itself, in the same storage.
+  uint32_t bytes = m_bytes;
+  cong->PktsAcked (state, 1, MilliSeconds (5));
+  NS_TEST_ASSERT_MSG_EQ (m_size, 1, "New min RTT did not drop the others");
+  NS_TEST_ASSERT_MSG_EQ (m_bytes, bytes, "Storage not reused");
+}
+
+static class TcpBbrTestSuite : public TestSuite
+{
+public:
+  TcpBbrTestSuite () : TestSuite ("tcp-bbr-test-suite", UNIT)
+  {
+    /* Test BW and RTT windows.
+     * Arguments in test:
+     *   time configuration for culling window
+     *   bottleneck rate (Mb/s) before it drops to one third
+     *   base RTT
+     *   ACKs per round
+     *   number of rounds
+     *   seed for estimate noise
+     */
+    AddTestCase (
+       new TcpBbrFilterTest (bbr::PACKET_TIME, 10, MilliSeconds (10),
+         10, 400, 1, "BW and RTT filters, packet time, 10 Mb/s"), TestCase::QUICK);
+    AddTestCase (
+       new TcpBbrFilterTest (bbr::WALLCLOCK_TIME, 10, MilliSeconds (10),
+         10, 400, 1, "BW and RTT filters, wallclock time, 10 Mb/s"), TestCase::QUICK);
+    AddTestCase (
+       new TcpBbrFilterTest (bbr::PACKET_TIME, 1000, MilliSeconds (100),
+         800, 200, 7, "BW and RTT filters, packet time, 1 Gb/s"), TestCase::QUICK);
+    AddTestCase (
+       new TcpBbrFilterTest (bbr::WALLCLOCK_TIME, 1000, MilliSeconds (100),
+         800, 200, 7, "BW and RTT filters, wallclock time, 1 Gb/s"), TestCase::QUICK);
+
+    /* Test BW and RTT windows on ACKs recorded from a chapter 6 run.
+     * Arguments in test:
+     *   time configuration for culling window
+     *   file of recorded ACKs
+     */
+    AddTestCase (
+       new TcpBbrFilterTest (bbr::PACKET_TIME, "tcp-bbr-test-acks.data",
+         "BW and RTT filters, packet time, recorded 10 Mb/s"), TestCase::QUICK);
+    AddTestCase (
+       new TcpBbrFilterTest (bbr::WALLCLOCK_TIME, "tcp-bbr-test-acks.data",
+         "BW and RTT filters, wallclock time, recorded 10 Mb/s"), TestCase::QUICK);
+
+    /* Test RTT window trace sources. */
+    AddTestCase (new TcpBbrRttTraceTest ("RTT window traces"),
+                 TestCase::QUICK);
+  }
+} g_tcpBbrTestSuite;
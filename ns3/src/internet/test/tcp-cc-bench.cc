@@ -0,0 +1,538 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Per-ACK CPU and memory cost of congestion control algorithms.
+//
+// Replays one ACK stream into each TcpCongestionOps of the comma separated
+// algorithms list, without connections, links or packets. A TcpSocketState
+// is driven the way TcpSocketBase::ProcessAck drives it: on each ACK the
+// algorithm gets GetSsThresh and CongestionStateSet when a loss starts a
+// recovery, PktsAcked, IncreaseWindow outside recovery, CongControl with a
+// rate sample of a TcpRateLinux, and Send for every segment the window
+// and rwnd then allow. Only these calls are timed and have their
+// allocations counted; the calls into the rate estimator (SkbSent,
+// SkbAcked, GenerateSample) are measured apart, as per-ACK work that
+// TcpSocketBase does for every algorithm. The stream does not react to
+// the window: an ACK for data beyond what the window allowed counts it
+// as sent.
+//
+// The stream is either synthetic (an ACK every ack_segments segments at
+// the bottleneck bandwidth, RTTs of delay plus up to jitter, and a loss
+// every loss_interval ACKs) or read from trace, with one ACK per line:
+//   time[s] segments-acked rtt[s] [loss]
+// where loss is 1 for the first ACK of a recovery; # starts a comment.
+// Prints one line per algorithm:
+//   algorithm acks ns/ack allocs/ack peak-heap[bytes]
+//     rate-ns/ack rate-allocs/ack rate-peak-heap[bytes] maxrss[KiB]
+// where peak-heap is the most memory held at once by allocations of the
+// algorithm, including its construction, the rate columns are the same
+// for the rate estimator, and maxrss is for the process so far (run one
+// algorithm per process to compare it). Build with
+// --build-profile=optimized for stable numbers, e.g.
+//   ./waf --run "tcp-cc-bench --acks=1000000"
+//   ./waf --run "tcp-cc-bench --algorithms=ns3::TcpBbr --trace=acks.txt"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/tcp-congestion-ops.h"
+#include "ns3/tcp-rate-ops.h"
+#include "ns3/tcp-socket-base.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpCcBench");
+
+// Heap accounting. Every block carries a header telling which counter,
+// if any, it was allocated under, so that its release can be charged
+// back wherever it happens.
+struct HeapCounter
+{
+  uint64_t m_allocations; // Allocations while counting.
+  size_t m_heap;          // Bytes held by counted allocations.
+  size_t m_peakHeap;      // Largest m_heap.
+};
+
+struct BlockHeader
+{
+  size_t m_size;          // Bytes asked for.
+  HeapCounter *m_counter; // Counter charged, 0 if none.
+};
+
+static const size_t HEADER_SIZE = 16; // Keeps the blocks aligned.
+static HeapCounter g_algorithmHeap;   // Calls into the algorithm.
+static HeapCounter g_rateHeap;        // Calls into the rate estimator.
+static HeapCounter *g_counting = 0;   // Counter of the measured call, if any.
+
+static void *
+CountedAlloc (size_t size)
+{
+  char *block = static_cast<char *> (std::malloc (size + HEADER_SIZE));
+  if (block == 0)
+    {
+      return 0;
+    }
+  BlockHeader *header = reinterpret_cast<BlockHeader *> (block);
+  header->m_size = size;
+  header->m_counter = g_counting;
+  if (g_counting)
+    {
+      g_counting->m_allocations++;
+      g_counting->m_heap += size;
+      g_counting->m_peakHeap = std::max (g_counting->m_peakHeap, g_counting->m_heap);
+    }
+  return block + HEADER_SIZE;
+}
+
+// Not inlined into operator delete, where the compiler would take the
+// std::free of a block from operator new for a mismatch.
+static void __attribute__ ((noinline))
+CountedFree (void *p)
+{
+  if (p == 0)
+    {
+      return;
+    }
+  char *block = static_cast<char *> (p) - HEADER_SIZE;
+  BlockHeader *header = reinterpret_cast<BlockHeader *> (block);
+  if (header->m_counter)
+    {
+      header->m_counter->m_heap -= header->m_size;
+    }
+  std::free (block);
+}
+
+void *
+operator new (size_t size)
+{
+  void *p = CountedAlloc (size);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void *
+operator new[] (size_t size)
+{
+  return operator new (size);
+}
+
+void *
+operator new (size_t size, const std::nothrow_t &) noexcept
+{
+  return CountedAlloc (size);
+}
+
+void *
+operator new[] (size_t size, const std::nothrow_t &) noexcept
+{
+  return CountedAlloc (size);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  CountedFree (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  CountedFree (p);
+}
+
+void
+operator delete (void *p, const std::nothrow_t &) noexcept
+{
+  CountedFree (p);
+}
+
+void
+operator delete[] (void *p, const std::nothrow_t &) noexcept
+{
+  CountedFree (p);
+}
+
+static long
+GetMaxRss (void)
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// One ACK of the stream.
+struct AckEvent
+{
+  Time m_time;         // Arrival time.
+  uint32_t m_segments; // Segments newly ACKed.
+  Time m_rtt;          // RTT sample.
+  bool m_loss;         // First ACK of a recovery.
+};
+
+static std::vector<AckEvent>
+MakeStream (uint32_t acks, uint32_t ackSegments, uint32_t segmentSize,
+            DataRate bandwidth, Time delay, Time jitter, uint32_t lossInterval,
+            uint32_t seed)
+{
+  std::mt19937 random (seed);
+  std::uniform_int_distribution<int64_t> extra (0, jitter.GetNanoSeconds ());
+  Time gap = bandwidth.CalculateBytesTxTime (ackSegments * segmentSize);
+  std::vector<AckEvent> stream;
+  for (uint32_t i = 0; i < acks; i++)
+    {
+      AckEvent ack;
+      ack.m_time = delay + NanoSeconds (gap.GetNanoSeconds () * i);
+      ack.m_segments = ackSegments;
+      ack.m_rtt = delay + NanoSeconds (extra (random));
+      ack.m_loss = lossInterval > 0 && i % lossInterval == lossInterval - 1;
+      stream.push_back (ack);
+    }
+  return stream;
+}
+
+static std::vector<AckEvent>
+ReadStream (const std::string &fileName)
+{
+  std::ifstream in (fileName.c_str ());
+  if (!in)
+    {
+      NS_FATAL_ERROR ("Cannot open ACK trace " << fileName);
+    }
+  std::vector<AckEvent> stream;
+  std::string line;
+  for (uint32_t number = 1; std::getline (in, line); number++)
+    {
+      line = line.substr (0, line.find ('#'));
+      std::istringstream fields (line);
+      double time, rtt;
+      uint32_t segments;
+      if (!(fields >> time))
+        {
+          continue;
+        }
+      if (!(fields >> segments >> rtt) || rtt <= 0
+          || (!stream.empty () && Seconds (time) < stream.back ().m_time))
+        {
+          NS_FATAL_ERROR ("Bad ACK at " << fileName << ":" << number);
+        }
+      int loss = 0;
+      fields >> loss;
+      AckEvent ack;
+      ack.m_time = Seconds (time);
+      ack.m_segments = segments;
+      ack.m_rtt = Seconds (rtt);
+      ack.m_loss = loss != 0;
+      stream.push_back (ack);
+    }
+  return stream;
+}
+
+// Socket given to the Send hook, with the bytes in flight of the replay.
+class ReplaySocket : public TcpSocketBase
+{
+public:
+  ReplaySocket ()
+    : m_inFlight (0)
+  {
+  }
+
+  virtual uint32_t BytesInFlight (void) const
+  {
+    return m_inFlight;
+  }
+
+  uint32_t m_inFlight;
+};
+
+// Sender side of one replay: a TcpSocketState whose window is always
+// used, limited by rwnd.
+class AckReplay
+{
+public:
+  AckReplay (Ptr<TcpCongestionOps> algorithm, const std::vector<AckEvent> &stream,
+             uint32_t segmentSize, uint32_t initialCwnd, uint32_t rwnd)
+    : m_algorithm (algorithm),
+      m_stream (stream),
+      m_rwnd (rwnd),
+      m_next (0),
+      m_elapsed (0),
+      m_rateElapsed (0),
+      m_rateCalls (0)
+  {
+    m_socket = CreateObject<ReplaySocket> ();
+    g_counting = &g_rateHeap;
+    m_rate = CreateObject<TcpRateLinux> ();
+    g_counting = 0;
+    m_tcb = CreateObject<TcpSocketState> ();
+    m_tcb->m_segmentSize = segmentSize;
+    m_tcb->m_initialCWnd = initialCwnd;
+    m_tcb->m_cWnd = initialCwnd * segmentSize;
+    m_tcb->m_initialSsThresh = UINT32_MAX;
+    m_tcb->m_ssThresh = UINT32_MAX;
+    m_tcb->m_lastAckedSeq = SequenceNumber32 (1);
+    m_tcb->m_highTxMark = SequenceNumber32 (1);
+    m_tcb->m_nextTxSequence = SequenceNumber32 (1);
+    m_tcb->m_minRtt = Time::Max ();
+    m_recover = SequenceNumber32 (1);
+  }
+
+  void Start (void)
+  {
+    Transmit (GetWindowSegments ());
+    ScheduleNext ();
+  }
+
+  double GetElapsed (void) const
+  {
+    return m_elapsed;
+  }
+
+  double GetRateElapsed (void) const
+  {
+    return m_rateElapsed;
+  }
+
+  // Measured calls into the rate estimator.
+  uint64_t GetRateCalls (void) const
+  {
+    return m_rateCalls;
+  }
+
+private:
+  void ScheduleNext (void)
+  {
+    if (m_next < m_stream.size ())
+      {
+        Simulator::Schedule (m_stream[m_next].m_time - Simulator::Now (),
+                             &AckReplay::Ack, this);
+      }
+  }
+
+  void Ack (void)
+  {
+    const AckEvent &ack = m_stream[m_next++];
+    uint32_t segmentSize = m_tcb->m_segmentSize;
+    SequenceNumber32 ackNumber = m_tcb->m_lastAckedSeq + ack.m_segments * segmentSize;
+    if (ackNumber > m_tcb->m_highTxMark.Get ())
+      {
+        // The stream ACKs more than the window allowed; it was sent anyway.
+        Transmit ((ackNumber - m_tcb->m_highTxMark.Get ()) / segmentSize);
+      }
+    m_tcb->m_minRtt = std::min (m_tcb->m_minRtt, ack.m_rtt);
+    m_tcb->m_rttSample = ack.m_rtt;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+    g_counting = &g_rateHeap;
+    m_rate->SkbAcked (ackNumber);
+    const TcpRateOps::TcpRateSample &sample = m_rate->GenerateSample (m_tcb->m_minRtt);
+    const TcpRateOps::TcpRateConnection &connection = m_rate->GetConnectionRate ();
+    g_counting = 0;
+    m_rateElapsed += std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+    m_rateCalls++;
+    uint32_t bytesInFlight = m_tcb->m_highTxMark.Get () - m_tcb->m_lastAckedSeq;
+
+    start = std::chrono::steady_clock::now ();
+    g_counting = &g_algorithmHeap;
+    if (ack.m_loss && m_tcb->m_congState == TcpSocketState::CA_OPEN)
+      {
+        // As TcpSocketBase::EnterRecovery, with SACK.
+        m_recover = m_tcb->m_highTxMark;
+        m_algorithm->CongestionStateSet (m_tcb, TcpSocketState::CA_RECOVERY);
+        m_tcb->m_congState = TcpSocketState::CA_RECOVERY;
+        m_tcb->m_ssThresh = m_algorithm->GetSsThresh (m_tcb, bytesInFlight);
+        m_tcb->m_cWnd = m_tcb->m_ssThresh;
+      }
+    m_tcb->m_lastAckedSeq = ackNumber;
+    m_algorithm->PktsAcked (m_tcb, ack.m_segments, ack.m_rtt);
+    if (m_tcb->m_congState == TcpSocketState::CA_RECOVERY && ackNumber >= m_recover)
+      {
+        m_algorithm->CongestionStateSet (m_tcb, TcpSocketState::CA_OPEN);
+        m_tcb->m_congState = TcpSocketState::CA_OPEN;
+      }
+    if (m_tcb->m_congState == TcpSocketState::CA_OPEN)
+      {
+        m_algorithm->IncreaseWindow (m_tcb, ack.m_segments);
+      }
+    m_algorithm->CongControl (m_tcb, connection, sample);
+    uint32_t segments = GetWindowSegments ();
+    SequenceNumber32 seq = m_tcb->m_highTxMark;
+    for (uint32_t i = 0; i < segments; i++, seq += segmentSize)
+      {
+        m_socket->m_inFlight = seq - m_tcb->m_lastAckedSeq;
+        m_algorithm->Send (m_socket, m_tcb, seq, false);
+      }
+    g_counting = 0;
+    m_elapsed += std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+    Transmit (segments);
+    ScheduleNext ();
+  }
+
+  // New segments the window allows.
+  uint32_t GetWindowSegments (void) const
+  {
+    uint32_t bytesInFlight = m_tcb->m_highTxMark.Get () - m_tcb->m_lastAckedSeq;
+    uint32_t window = std::min (m_tcb->m_cWnd.Get (), m_rwnd);
+    return window > bytesInFlight ? (window - bytesInFlight) / m_tcb->m_segmentSize : 0;
+  }
+
+  // Stamp segments in the rate estimator and advance the send sequence.
+  void Transmit (uint32_t segments)
+  {
+    if (segments == 0)
+      {
+        return;
+      }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+    g_counting = &g_rateHeap;
+    for (uint32_t i = 0; i < segments; i++)
+      {
+        SequenceNumber32 seq = m_tcb->m_highTxMark;
+        m_rate->SkbSent (seq, m_tcb->m_segmentSize, seq == m_tcb->m_lastAckedSeq);
+        m_tcb->m_highTxMark = seq + m_tcb->m_segmentSize;
+      }
+    g_counting = 0;
+    m_rateElapsed += std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+    m_rateCalls++;
+    m_tcb->m_nextTxSequence = m_tcb->m_highTxMark;
+  }
+
+  Ptr<TcpCongestionOps> m_algorithm;
+  const std::vector<AckEvent> &m_stream;
+  Ptr<ReplaySocket> m_socket;
+  Ptr<TcpRateOps> m_rate;
+  Ptr<TcpSocketState> m_tcb;
+  uint32_t m_rwnd;            // Receive window (bytes).
+  SequenceNumber32 m_recover; // End of the current recovery.
+  size_t m_next;              // Next ACK of m_stream.
+  double m_elapsed;           // Time in the algorithm (ns).
+  double m_rateElapsed;       // Time in the rate estimator (ns).
+  uint64_t m_rateCalls;       // Measurements of m_rateElapsed.
+};
+
+// Cost of an empty measurement, subtracted from the results (ns).
+static double
+MeasureOverhead (uint32_t rounds)
+{
+  double elapsed = 0;
+  for (uint32_t i = 0; i < rounds; i++)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      g_counting = &g_algorithmHeap;
+      g_counting = 0;
+      elapsed += std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+    }
+  return elapsed / rounds;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string algorithms = "ns3::TcpNewReno,ns3::TcpHighSpeed,ns3::TcpBic,ns3::TcpVegas,ns3::TcpCubic,ns3::TcpBbr";
+  std::string trace = "";
+  uint32_t acks = 200000;
+  uint32_t ack_segments = 2;
+  uint32_t segment_size = 1448;
+  uint32_t initial_cwnd = 10;
+  uint32_t rwnd = 4194304;
+  std::string bandwidth = "100Mbps";
+  std::string delay = "20ms";
+  std::string jitter = "1ms";
+  uint32_t loss_interval = 5000;
+  uint32_t seed = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("algorithms", "Comma separated TypeIds of the congestion control algorithms", algorithms);
+  cmd.AddValue ("trace", "File to read the ACK stream from instead of generating it", trace);
+  cmd.AddValue ("acks", "ACKs of the synthetic stream", acks);
+  cmd.AddValue ("ack_segments", "Segments ACKed by each synthetic ACK", ack_segments);
+  cmd.AddValue ("segment_size", "Segment size in bytes", segment_size);
+  cmd.AddValue ("initial_cwnd", "Initial congestion window in segments", initial_cwnd);
+  cmd.AddValue ("rwnd", "Receive window in bytes", rwnd);
+  cmd.AddValue ("bandwidth", "Bottleneck bandwidth of the synthetic stream", bandwidth);
+  cmd.AddValue ("delay", "Base RTT of the synthetic stream", delay);
+  cmd.AddValue ("jitter", "Largest extra RTT of the synthetic stream", jitter);
+  cmd.AddValue ("loss_interval", "ACKs between losses of the synthetic stream, 0 for none", loss_interval);
+  cmd.AddValue ("seed", "Seed of the synthetic RTTs", seed);
+  cmd.Parse (argc, argv);
+
+  std::vector<AckEvent> stream;
+  if (trace.empty ())
+    {
+      stream = MakeStream (acks, ack_segments, segment_size, DataRate (bandwidth),
+                           Time (delay), Time (jitter), loss_interval, seed);
+    }
+  else
+    {
+      stream = ReadStream (trace);
+    }
+  if (stream.empty ())
+    {
+      NS_FATAL_ERROR ("No ACKs to replay");
+    }
+  double overhead = MeasureOverhead (stream.size ());
+
+  std::istringstream names (algorithms);
+  std::string name;
+  while (std::getline (names, name, ','))
+    {
+      TypeId tid;
+      if (!TypeId::LookupByNameFailSafe (name, &tid)
+          || !tid.IsChildOf (TcpCongestionOps::GetTypeId ()))
+        {
+          NS_FATAL_ERROR ("Unknown congestion control algorithm " << name);
+        }
+      ObjectFactory factory;
+      factory.SetTypeId (tid);
+
+      g_algorithmHeap = HeapCounter ();
+      g_rateHeap = HeapCounter ();
+      g_counting = &g_algorithmHeap;
+      Ptr<TcpCongestionOps> algorithm = factory.Create<TcpCongestionOps> ();
+      g_counting = 0;
+      g_algorithmHeap.m_allocations = 0;
+
+      AckReplay replay (algorithm, stream, segment_size, initial_cwnd, rwnd);
+      g_rateHeap.m_allocations = 0;
+      replay.Start ();
+      Simulator::Run ();
+      Simulator::Destroy ();
+
+      double ns = std::max (0.0, replay.GetElapsed () / stream.size () - overhead);
+      double rateNs = std::max (0.0, (replay.GetRateElapsed ()
+                                      - overhead * replay.GetRateCalls ()) / stream.size ());
+      std::cout << name << " " << stream.size () << " " << ns << " "
+                << (double) g_algorithmHeap.m_allocations / stream.size () << " "
+                << g_algorithmHeap.m_peakHeap << " " << rateNs << " "
+                << (double) g_rateHeap.m_allocations / stream.size () << " "
+                << g_rateHeap.m_peakHeap << " " << GetMaxRss () << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,206 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Speed and accuracy of TcpCubic::CubicRoot.
+//
+// Compares TcpCubic::CubicRoot with the routine it replaced (the Linux
+// 3.11 / ns-2 one: a 64 entry table, fls64 built from bit tests, and one
+// Newton-Raphson iteration). The inputs are samples per bit length
+// over the full 64-bit range, plus the largest value of each bit length.
+// Prints one line per routine:
+//   routine ns/op max-abs-error max-rel-error
+// where the errors are against the exact integer cube root, e.g.
+//   ./waf --run "tcp-cubic-root-bench --samples=100000"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/tcp-cubic.h"
+
+using namespace ns3;
+
+// Keeps the timed calls from being optimized away.
+static volatile uint64_t g_sink;
+
+// TcpCubic::CubicRoot and fls64 before they used a generated table and
+// __builtin_clzll, as in Linux 3.11 and ns-2.
+static int
+OldFls (int x)
+{
+  int r = 32;
+
+  if (!x)
+    {
+      return 0;
+    }
+  if (!(x & 0xffff0000u))
+    {
+      x <<= 16;
+      r -= 16;
+    }
+  if (!(x & 0xff000000u))
+    {
+      x <<= 8;
+      r -= 8;
+    }
+  if (!(x & 0xf0000000u))
+    {
+      x <<= 4;
+      r -= 4;
+    }
+  if (!(x & 0xc0000000u))
+    {
+      x <<= 2;
+      r -= 2;
+    }
+  if (!(x & 0x80000000u))
+    {
+      x <<= 1;
+      r -= 1;
+    }
+  return r;
+}
+
+static uint32_t
+OldFls64 (uint64_t x)
+{
+  uint32_t h = x >> 32;
+  if (h)
+    {
+      return OldFls (h) + 32;
+    }
+  return OldFls (x);
+}
+
+static uint32_t
+OldCubicRoot (uint64_t a)
+{
+  uint32_t x, b, shift;
+  static const uint8_t v[] = {
+    /* 0x00 */    0,   54,   54,   54,  118,  118,  118,  118,
+    /* 0x08 */  123,  129,  134,  138,  143,  147,  151,  156,
+    /* 0x10 */  157,  161,  164,  168,  170,  173,  176,  179,
+    /* 0x18 */  181,  185,  187,  190,  192,  194,  197,  199,
+    /* 0x20 */  200,  202,  204,  206,  209,  211,  213,  215,
+    /* 0x28 */  217,  219,  221,  222,  224,  225,  227,  229,
+    /* 0x30 */  231,  232,  234,  236,  237,  239,  240,  242,
+    /* 0x38 */  244,  245,  246,  248,  250,  251,  252,  254,
+  };
+  b = OldFls64 (a);
+  if (b < 7)
+    {
+      return ((uint32_t)v[(uint32_t)a] + 35) >> 6;
+    }
+
+  b = ((b * 84) >> 8) - 1;
+  shift = (a >> (b * 3));
+  x = ((uint32_t)(((uint32_t)v[shift] + 10) << b)) >> 6;
+  x = (2 * x + (uint32_t)(a / ((uint64_t)x * (uint64_t)(x - 1))));
+  x = ((x * 341) >> 10);
+  return x;
+}
+
+// Largest x with x^3 <= a.
+static uint32_t
+ExactCubicRoot (uint64_t a)
+{
+  const uint64_t max = 2642245; // 2642245^3 < 2^64 < 2642246^3
+  uint64_t x = std::min<uint64_t> (std::cbrt ((double) a), max);
+  while (x > 0 && x * x * x > a)
+    {
+      x--;
+    }
+  while (x < max && (x + 1) * (x + 1) * (x + 1) <= a)
+    {
+      x++;
+    }
+  return x;
+}
+
+static void
+Measure (const std::string &name, uint32_t (*root) (uint64_t),
+         const std::vector<uint64_t> &inputs, const std::vector<uint32_t> &exact,
+         uint32_t rounds)
+{
+  uint64_t sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      for (size_t i = 0; i < inputs.size (); i++)
+        {
+          sum += root (inputs[i]);
+        }
+    }
+  double ns = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - start).count ();
+
+  int64_t maxAbs = 0;
+  double maxRel = 0;
+  for (size_t i = 0; i < inputs.size (); i++)
+    {
+      int64_t error = std::llabs ((int64_t) root (inputs[i]) - exact[i]);
+      maxAbs = std::max (maxAbs, error);
+      if (exact[i] > 0)
+        {
+          maxRel = std::max (maxRel, (double) error / exact[i]);
+        }
+    }
+
+  g_sink = sum;
+  std::cout << name << " " << ns / rounds / inputs.size () << " " << maxAbs
+            << " " << maxRel << std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t samples = 10000;
+  uint32_t rounds = 20;
+  uint32_t seed = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("samples", "Random inputs per bit length", samples);
+  cmd.AddValue ("rounds", "Timed passes over the inputs", rounds);
+  cmd.AddValue ("seed", "Seed of the random inputs", seed);
+  cmd.Parse (argc, argv);
+
+  std::mt19937_64 random (seed);
+  std::vector<uint64_t> inputs;
+  inputs.push_back (0);
+  for (uint32_t bits = 1; bits <= 64; bits++)
+    {
+      uint64_t top = 1ull << (bits - 1);
+      inputs.push_back (top | (top - 1));
+      for (uint32_t i = 0; i < samples; i++)
+        {
+          inputs.push_back (top | (random () & (top - 1)));
+        }
+    }
+  std::shuffle (inputs.begin (), inputs.end (), random);
+  std::vector<uint32_t> exact;
+  for (size_t i = 0; i < inputs.size (); i++)
+    {
+      exact.push_back (ExactCubicRoot (inputs[i]));
+    }
+
+  Measure ("old", &OldCubicRoot, inputs, exact, rounds);
+  Measure ("new", &TcpCubic::CubicRoot, inputs, exact, rounds);
+  return 0;
+}
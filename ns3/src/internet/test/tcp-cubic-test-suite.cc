@@ -28,13 +28,19 @@
  */
 
 #include "ns3/tcp-cubic.h"
+#include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-header.h"
+#include "ns3/rtt-estimator.h"
 #include "ns3/test.h"
 #include "ns3/core-module.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
 using namespace ns3;
 
+#include<algorithm>
+#include<deque>
 #include<iostream>
+#include<vector>
 using namespace std;
 
 NS_LOG_COMPONENT_DEFINE ("TcpCubicTestSuite");
@@ -56,7 +62,7 @@ public:
     uint32_t cWnd1,
     uint32_t segmentSize,
     uint32_t timeOfCubicUpdate,
-    uint32_t ackTimestampToEcho,
+    uint32_t rtt,
     int expectedAckCnt,
     uint32_t cWnd2,
     uint32_t time2,
@@ -88,7 +94,7 @@ private:
   Ptr<TcpSocketState> m_state;
   Ptr<TcpCubic> m_cong;
   uint32_t m_timeOfCubicUpdate;
-  uint32_t m_ackTimestampToEcho;
+  uint32_t m_rtt;
   int m_expectedAckCnt;
   uint32_t m_cWnd2;
   uint32_t m_time2;
@@ -108,7 +114,7 @@ TcpCubicIncrementTest::TcpCubicIncrementTest (
     uint32_t cWnd1,
     uint32_t segmentSize,
     uint32_t timeOfCubicUpdate,
-    uint32_t ackTimestampToEcho,
+    uint32_t rtt,
     int expectedAckCnt,
     uint32_t cWnd2,
     uint32_t time2,
@@ -125,7 +131,7 @@ TcpCubicIncrementTest::TcpCubicIncrementTest (
   m_cWnd1 (cWnd1),
   m_segmentSize (segmentSize),
   m_timeOfCubicUpdate(timeOfCubicUpdate),
-  m_ackTimestampToEcho(ackTimestampToEcho),
+  m_rtt(rtt),
   m_expectedAckCnt(expectedAckCnt),
   m_cWnd2(cWnd2),
   m_time2(time2),
@@ -195,9 +201,11 @@ TcpCubicIncrementTest::RunCubicUpdate ()
     }
 
   m_state->m_cWnd = cwnd;
-  m_state->m_rcvTimestampEchoReply = m_ackTimestampToEcho;
 
-  // Call as if a TCP packet came in
+  // Call as if a TCP packet came in. The smoothed RTT TcpSocketBase passes
+  // is not the sample of this ACK, so give one CUBIC must not take.
+  m_state->m_rttSample = MicroSeconds (m_rtt);
+  m_cong->PktsAcked (m_state, 1, MicroSeconds (2 * m_rtt));
   m_cong->IncreaseWindow (m_state, 1);
 }
 
@@ -429,6 +437,870 @@ TcpCubicPktsAckedTest::DoRun (void)
 }
 
 
+/*
+ * Check CubicRoot around perfect cubes over the full 64-bit range: the cube
+ * root of k^3 is k, and that of k^3 - 1 is k - 1, give or take 1.
+ */
+class TcpCubicRootTest : public TestCase
+{
+public:
+  TcpCubicRootTest(const std::string &name);
+
+private:
+  // NS-3 Test method
+  virtual void DoRun (void);
+};
+
+TcpCubicRootTest::TcpCubicRootTest (const std::string &name)
+  : TestCase (name)
+{
+}
+
+//
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+//
+void
+TcpCubicRootTest::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ(TcpCubic::CubicRoot (0), 0, "Wrong cube root of 0.");
+  for (uint32_t k = 1; k < 512; k++)
+    {
+      uint64_t a = (uint64_t) k * k * k;
+      NS_TEST_ASSERT_MSG_EQ(TcpCubic::CubicRoot (a), k, "Wrong cube root of " << a);
+      NS_TEST_ASSERT_MSG_EQ(TcpCubic::CubicRoot (a - 1), k - 1, "Wrong cube root of " << a - 1);
+    }
+  // 2642245^3 < 2^64 < 2642246^3
+  for (uint64_t k = 512; k <= 2642245; k += k / 64 + 1)
+    {
+      uint64_t a = k * k * k;
+      NS_TEST_ASSERT_MSG_EQ_TOL(TcpCubic::CubicRoot (a), k, 1, "Wrong cube root of " << a);
+      NS_TEST_ASSERT_MSG_EQ_TOL(TcpCubic::CubicRoot (a - 1), k - 1, 1, "Wrong cube root of " << a - 1);
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL(TcpCubic::CubicRoot (UINT64_MAX), 2642245, 1,
+    "Wrong cube root of 2^64 - 1");
+}
+
+
+/*
+ * Check that delayed ACKs do not slow down the window growth. Two CUBIC
+ * flows see the same constant RTT; the receiver of one ACKs every segment,
+ * that of the other every segmentsPerAck segments. Each round the flows send
+ * their cwnd and the ACKs come back evenly spread over the RTT. Both flows
+ * must reach the same cwnd, in slow start exactly.
+ */
+class TcpCubicDelayedAckTest : public TestCase
+{
+public:
+  TcpCubicDelayedAckTest(
+    uint32_t segmentsPerAck,
+    bool slowStart,
+    uint32_t rounds,
+    const std::string &name);
+
+private:
+  // NS-3 Test method
+  virtual void DoRun (void);
+
+  // Send a round of cwnd segments of a flow and schedule their ACKs.
+  void Round (uint32_t flow, uint32_t round);
+
+  // Receive an ACK of a flow.
+  void Ack (uint32_t flow, uint32_t segmentsAcked);
+
+  uint32_t m_segmentsPerAck;
+  bool m_slowStart;
+  uint32_t m_rounds;
+  Ptr<TcpSocketState> m_state[2]; // Flow 0 ACKs every segment.
+  Ptr<TcpCubic> m_cong[2];
+};
+
+TcpCubicDelayedAckTest::TcpCubicDelayedAckTest (
+    uint32_t segmentsPerAck,
+    bool slowStart,
+    uint32_t rounds,
+    const std::string &name)
+  : TestCase (name),
+  m_segmentsPerAck(segmentsPerAck),
+  m_slowStart(slowStart),
+  m_rounds(rounds)
+{
+}
+
+void
+TcpCubicDelayedAckTest::Round (uint32_t flow, uint32_t round)
+{
+  if (round == m_rounds)
+    {
+      return;
+    }
+
+  uint64_t rttUs = 100000;
+  uint32_t segments = m_state[flow]->GetCwndInSegments ();
+  uint32_t perAck = flow == 0 ? 1 : m_segmentsPerAck;
+  for (uint32_t sent = 0; sent < segments; sent += perAck)
+    {
+      uint32_t acked = std::min (perAck, segments - sent);
+      Simulator::Schedule (MicroSeconds (rttUs * (sent + acked) / segments),
+                           &TcpCubicDelayedAckTest::Ack, this, flow, acked);
+    }
+  Simulator::Schedule (MicroSeconds (rttUs),
+                       &TcpCubicDelayedAckTest::Round, this, flow, round + 1);
+}
+
+void
+TcpCubicDelayedAckTest::Ack (uint32_t flow, uint32_t segmentsAcked)
+{
+  Ptr<TcpSocketState> state = m_state[flow];
+  state->m_rcvTimestampEchoReply = Simulator::Now ().GetMilliSeconds () - 100;
+  state->m_lastAckedSeq = state->m_lastAckedSeq + segmentsAcked * state->m_segmentSize;
+  state->m_rttSample = MilliSeconds (100);
+  m_cong[flow]->PktsAcked (state, segmentsAcked, state->m_rttSample);
+  m_cong[flow]->IncreaseWindow (state, segmentsAcked);
+}
+
+//
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+//
+void
+TcpCubicDelayedAckTest::DoRun (void)
+{
+
+  // Log the test.
+  LogComponentEnable("TcpCubic", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCongestionOps", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCubicTestSuite", LOG_LEVEL_INFO);
+
+  for (uint32_t flow = 0; flow < 2; flow++)
+    {
+      m_state[flow] = CreateObject<TcpSocketState> ();
+      m_state[flow]->m_segmentSize = 1000;
+      m_state[flow]->m_congState = TcpSocketState::CA_OPEN;
+      m_cong[flow] = CreateObject <TcpCubic> ();
+      if (m_slowStart)
+        {
+          m_state[flow]->m_cWnd = 10 * 1000;
+          m_state[flow]->m_ssThresh = UINT32_MAX;
+        }
+      else
+        {
+          // Start congestion avoidance after a loss at 100 segments.
+          m_state[flow]->m_cWnd = 100 * 1000;
+          m_state[flow]->m_ssThresh = m_cong[flow]->GetSsThresh (m_state[flow], 0);
+          m_state[flow]->m_cWnd = m_state[flow]->m_ssThresh;
+        }
+      Simulator::ScheduleNow (&TcpCubicDelayedAckTest::Round, this, flow, 0);
+    }
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  uint32_t cwnd = m_state[0]->GetCwndInSegments ();
+  uint32_t cwndDelayed = m_state[1]->GetCwndInSegments ();
+  NS_LOG_INFO ("cwnd " << cwnd << " segments, with delayed ACKs " << cwndDelayed);
+  NS_TEST_ASSERT_MSG_GT(cwnd, m_slowStart ? 10u : 100u,
+    "cwnd did not grow.");
+  if (m_slowStart)
+    {
+      NS_TEST_ASSERT_MSG_EQ(cwndDelayed, cwnd,
+        "Delayed ACKs slowed down slow start.");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL(cwndDelayed, cwnd, cwnd / 50,
+        "Delayed ACKs slowed down congestion avoidance.");
+    }
+}
+
+
+/*
+ * Check that cwnd does not grow while the application, not cwnd, limits the
+ * sender. TcpCubic learns this from the Send calls of the socket: a new
+ * socket has nothing in flight, so sending one segment uses a small part of
+ * cwnd. Once a segment fills cwnd the flow is cwnd limited again.
+ */
+class TcpCubicAppLimitedTest : public TestCase
+{
+public:
+  TcpCubicAppLimitedTest(
+    bool slowStart,
+    const std::string &name);
+
+private:
+  // NS-3 Test method
+  virtual void DoRun (void);
+
+  bool m_slowStart;
+};
+
+TcpCubicAppLimitedTest::TcpCubicAppLimitedTest (
+    bool slowStart,
+    const std::string &name)
+  : TestCase (name),
+  m_slowStart(slowStart)
+{
+}
+
+//
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+//
+void
+TcpCubicAppLimitedTest::DoRun (void)
+{
+
+  // Log the test.
+  LogComponentEnable("TcpCubic", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCongestionOps", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCubicTestSuite", LOG_LEVEL_INFO);
+
+  uint32_t segmentSize = 1000;
+  Ptr<TcpSocketState> state = CreateObject<TcpSocketState> ();
+  state->m_segmentSize = segmentSize;
+  state->m_cWnd = 20 * segmentSize;
+  state->m_ssThresh = m_slowStart ? UINT32_MAX : 10 * segmentSize;
+  state->m_congState = TcpSocketState::CA_OPEN;
+
+  Ptr<TcpSocketBase> socket = CreateObject<TcpSocketBase> ();
+  Ptr<TcpCubic> cong = CreateObject <TcpCubic> ();
+
+  // One segment in flight out of a cwnd of 20.
+  cong->Send (socket, state, SequenceNumber32 (0), false);
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      cong->IncreaseWindow (state, 1);
+    }
+  NS_TEST_ASSERT_MSG_EQ(state->m_cWnd.Get (), 20 * segmentSize,
+    "cwnd grew while the application limited the sender.");
+
+  // A segment that fills cwnd.
+  state->m_cWnd = segmentSize;
+  cong->Send (socket, state, SequenceNumber32 (0), false);
+  cong->IncreaseWindow (state, 1);
+  NS_TEST_ASSERT_MSG_GT(state->m_cWnd.Get (), segmentSize,
+    "cwnd did not grow when cwnd limited the sender.");
+}
+
+
+/*
+ * Unit test of HyStart++. Drives PktsAcked and IncreaseWindow one ACK at a
+ * time through slow start, with the RTT raised by rttIncrease from round 4
+ * on (and back to the base RTT from round 6 on if rttRecovers), and checks
+ * when Conservative Slow Start (CSS) is entered and left.
+ */
+class TcpCubicHyStartTest : public TestCase
+{
+public:
+  TcpCubicHyStartTest(
+    uint32_t rttIncrease,
+    bool rttRecovers,
+    bool expectCss,
+    bool expectExit,
+    const std::string &name);
+
+private:
+  // NS-3 Test method
+  virtual void DoRun (void);
+
+  /*
+   * Record the rounds in which CSS is entered and left.
+   */
+  void CssCheck(bool, bool);
+
+  uint32_t m_rttIncrease;
+  bool m_rttRecovers;
+  bool m_expectCss;
+  bool m_expectExit;
+  uint32_t m_round;     // Current round of the test.
+  int m_cssEnterRound;  // Round in which CSS was entered, -1 if never.
+  int m_cssLeaveRound;  // Round in which CSS was left, -1 if never.
+};
+
+TcpCubicHyStartTest::TcpCubicHyStartTest (
+    uint32_t rttIncrease,
+    bool rttRecovers,
+    bool expectCss,
+    bool expectExit,
+    const std::string &name)
+  : TestCase (name),
+  m_rttIncrease(rttIncrease),
+  m_rttRecovers(rttRecovers),
+  m_expectCss(expectCss),
+  m_expectExit(expectExit),
+  m_round(0),
+  m_cssEnterRound(-1),
+  m_cssLeaveRound(-1)
+{
+}
+
+void
+TcpCubicHyStartTest::CssCheck (bool oldValue, bool newValue)
+{
+  if (newValue)
+    {
+      m_cssEnterRound = m_round;
+    }
+  else
+    {
+      m_cssLeaveRound = m_round;
+    }
+}
+
+//
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+//
+void
+TcpCubicHyStartTest::DoRun (void)
+{
+
+  // Log the test.
+  LogComponentEnable("TcpCubic", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCongestionOps", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCubicTestSuite", LOG_LEVEL_INFO);
+
+  // Setup the basic TCP state for the test: slow start with 10 segments.
+  uint32_t segmentSize = 1000;
+  Ptr<TcpSocketState> state = CreateObject<TcpSocketState> ();
+  state->m_segmentSize = segmentSize;
+  state->m_cWnd = 10 * segmentSize;
+  state->m_ssThresh = UINT32_MAX;
+  state->m_congState = TcpSocketState::CA_OPEN;
+  state->m_highTxMark = SequenceNumber32 (state->m_cWnd);
+
+  // Set Cubic as the congestion control algorithm
+  Ptr<TcpCubic> cong = CreateObject <TcpCubic> ();
+
+  cong->TraceConnectWithoutContext ("ConservativeSlowStart",
+    MakeCallback (&TcpCubicHyStartTest::CssCheck, this));
+
+  // Every segment is ACKed separately, and the sender fills cwnd right
+  // away. A round ends when the data sent at its start has been ACKed.
+  SequenceNumber32 windowEnd (0);
+  while (m_round <= 12 && state->m_cWnd < state->m_ssThresh)
+    {
+      state->m_lastAckedSeq = state->m_lastAckedSeq + segmentSize;
+      if (state->m_lastAckedSeq >= windowEnd)
+        {
+          windowEnd = state->m_highTxMark;
+          m_round++;
+        }
+
+      Time rtt = MilliSeconds (100);
+      if (m_round >= 4 && !(m_rttRecovers && m_round >= 6))
+        {
+          rtt = rtt + MilliSeconds (m_rttIncrease);
+        }
+      state->m_rttSample = rtt;
+      cong->PktsAcked (state, 1, rtt);
+      cong->IncreaseWindow (state, 1);
+      state->m_highTxMark = state->m_lastAckedSeq + state->m_cWnd;
+    }
+
+  NS_TEST_ASSERT_MSG_EQ(m_cssEnterRound == 4, m_expectCss,
+    "CSS not entered in the round of the RTT increase as expected.");
+  if (m_rttRecovers)
+    {
+      NS_TEST_ASSERT_MSG_EQ(m_cssLeaveRound, 6,
+        "Slow start not resumed when the RTT fell.");
+    }
+  NS_TEST_ASSERT_MSG_EQ(state->m_ssThresh < UINT32_MAX, m_expectExit,
+    "Slow start left unexpectedly or not left.");
+  if (m_expectExit)
+    {
+      // CssRounds defaults to 5.
+      NS_TEST_ASSERT_MSG_EQ(m_cssLeaveRound, m_cssEnterRound + 5,
+        "Slow start not left after the CSS rounds.");
+      NS_TEST_ASSERT_MSG_EQ(state->m_ssThresh, state->m_cWnd,
+        "ssthresh not set to cwnd when leaving slow start.");
+    }
+}
+
+
+/*
+ * Socket that takes RTT samples as TcpSocketBase does when it sends a
+ * segment and receives an ACK, without a connection around it.
+ */
+class TcpCubicRttSocket : public TcpSocketBase
+{
+public:
+  // Segment [seq, seq + size) is sent now.
+  void SendSegment (SequenceNumber32 seq, uint32_t size)
+  {
+    UpdateRttHistory (seq, size, false);
+  }
+
+  // An ACK of ack is received now. Returns the smoothed RTT, which
+  // TcpSocketBase passes to PktsAcked.
+  Time ReceiveAck (SequenceNumber32 ack)
+  {
+    TcpHeader header;
+    header.SetFlags (TcpHeader::ACK);
+    header.SetAckNumber (ack);
+    EstimateRtt (header);
+    return m_lastRtt;
+  }
+
+  Ptr<TcpSocketState> GetTcb (void) const
+  {
+    return m_tcb;
+  }
+};
+
+/*
+ * HyStart++ with RTT samples taken by TcpSocketBase::EstimateRtt. Segments
+ * are sent as cwnd allows and ACKed one RTT later, the RTT raised by
+ * rttIncrease from the last segment of the initial window on. Round 2
+ * starts with the ACK of that segment, so all its samples have the
+ * increase and CSS is entered in round 2. The smoothed RTT passed to
+ * PktsAcked starts round 2 an eighth of the way up and would only enter
+ * CSS a round later.
+ */
+class TcpCubicHyStartRttTest : public TestCase
+{
+public:
+  TcpCubicHyStartRttTest(
+    uint32_t rttIncrease,
+    bool expectCss,
+    const std::string &name);
+
+private:
+  // NS-3 Test method
+  virtual void DoRun (void);
+
+  // Send as much as cwnd allows.
+  void SendData(void);
+
+  // The ACK of the data before ack arrives.
+  void ReceiveAck(SequenceNumber32 ack);
+
+  // Record the round in which CSS is entered.
+  void CssCheck(bool, bool);
+
+  uint32_t m_rttIncrease;
+  bool m_expectCss;
+  Ptr<TcpCubicRttSocket> m_socket;
+  Ptr<TcpSocketState> m_state;
+  Ptr<TcpCubic> m_cong;
+  SequenceNumber32 m_windowEnd; // End of the current round.
+  uint32_t m_round;             // Current round of the test.
+  int m_cssEnterRound;          // Round in which CSS was entered, -1 if never.
+};
+
+TcpCubicHyStartRttTest::TcpCubicHyStartRttTest (
+    uint32_t rttIncrease,
+    bool expectCss,
+    const std::string &name)
+  : TestCase (name),
+  m_rttIncrease(rttIncrease),
+  m_expectCss(expectCss),
+  m_windowEnd(0),
+  m_round(0),
+  m_cssEnterRound(-1)
+{
+}
+
+void
+TcpCubicHyStartRttTest::CssCheck (bool oldValue, bool newValue)
+{
+  if (newValue && m_cssEnterRound < 0)
+    {
+      m_cssEnterRound = m_round;
+    }
+}
+
+void
+TcpCubicHyStartRttTest::SendData (void)
+{
+  while (m_state->m_highTxMark.Get () < m_state->m_lastAckedSeq + m_state->m_cWnd)
+    {
+      SequenceNumber32 seq = m_state->m_highTxMark;
+      Time rtt = MilliSeconds (100);
+      if (seq.GetValue () >= 9 * m_state->m_segmentSize)
+        {
+          rtt = rtt + MilliSeconds (m_rttIncrease);
+        }
+      m_socket->SendSegment (seq, m_state->m_segmentSize);
+      m_state->m_highTxMark = seq + m_state->m_segmentSize;
+      Simulator::Schedule (rtt, &TcpCubicHyStartRttTest::ReceiveAck, this,
+                           m_state->m_highTxMark.Get ());
+    }
+}
+
+void
+TcpCubicHyStartRttTest::ReceiveAck (SequenceNumber32 ack)
+{
+  // As TcpSocketBase: the RTT sample is taken before the ACK is processed.
+  Time srtt = m_socket->ReceiveAck (ack);
+  m_state->m_lastAckedSeq = ack;
+  if (m_state->m_lastAckedSeq >= m_windowEnd)
+    {
+      m_windowEnd = m_state->m_highTxMark;
+      m_round++;
+    }
+  m_cong->PktsAcked (m_state, 1, srtt);
+  m_cong->IncreaseWindow (m_state, 1);
+  if (m_round <= 8 && m_state->m_cWnd < m_state->m_ssThresh)
+    {
+      SendData ();
+    }
+}
+
+//
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+//
+void
+TcpCubicHyStartRttTest::DoRun (void)
+{
+  m_socket = CreateObject<TcpCubicRttSocket> ();
+  m_socket->SetRtt (CreateObject<RttMeanDeviation> ());
+
+  // Slow start with 10 segments.
+  m_state = m_socket->GetTcb ();
+  m_state->m_segmentSize = 1000;
+  m_state->m_cWnd = 10 * m_state->m_segmentSize;
+  m_state->m_ssThresh = UINT32_MAX;
+  m_state->m_congState = TcpSocketState::CA_OPEN;
+
+  m_cong = CreateObject <TcpCubic> ();
+  m_cong->TraceConnectWithoutContext ("ConservativeSlowStart",
+    MakeCallback (&TcpCubicHyStartRttTest::CssCheck, this));
+
+  SendData ();
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ(m_cssEnterRound == 2, m_expectCss,
+    "CSS not entered in the round of the RTT increase as expected.");
+  if (!m_expectCss)
+    {
+      NS_TEST_ASSERT_MSG_EQ(m_cssEnterRound, -1, "CSS entered unexpectedly.");
+    }
+}
+
+
+/*
+ * Compare slow start with and without HyStart++ on a model of one flow
+ * through a bottleneck with a drop-tail buffer. Each segment waits for the
+ * segments before it in the buffer, is sent at the bottleneck rate and is
+ * ACKed one base RTT later; arriving at a full buffer it is dropped. Losses
+ * are detected when a segment sent three segments later is ACKed, repaired
+ * as in SACK recovery (RFC 6675), and by a 1 s retransmission timeout if
+ * the ACKs stop. The test checks that HyStart++ lowers the peak buffer
+ * occupancy and reaches steady throughput earlier: the receiver gets data in
+ * order at 90% of the bottleneck rate in every RTT from then on.
+ */
+class TcpCubicHyStartBottleneckTest : public TestCase
+{
+public:
+  TcpCubicHyStartBottleneckTest(
+    uint32_t bandwidth,
+    uint32_t rtt,
+    uint32_t buffer,
+    bool expectLowerPeak,
+    const std::string &name);
+
+private:
+  // NS-3 Test method
+  virtual void DoRun (void);
+
+  // Simulate the flow for m_duration, with or without HyStart++.
+  void RunFlow(bool hyStart, uint32_t &peakQueue, Time &steadyTime);
+
+  // Send as much as cwnd allows, retransmissions first.
+  void SendData(void);
+
+  // Put segment i into the bottleneck buffer.
+  void Transmit(uint32_t i);
+
+  // The ACK of segment i, sent at sendTime, arrives.
+  void ReceiveAck(uint32_t i, uint32_t order, Time sendTime);
+
+  // The retransmission timer expires.
+  void Timeout(void);
+
+  // Check the in-order goodput of the last RTT.
+  void Sample(void);
+
+  enum SegmentState { IN_FLIGHT, DROPPED, LOST, ACKED };
+
+  uint32_t m_bandwidth;   // Bottleneck bandwidth (Mbps).
+  Time m_rtt;             // Base RTT.
+  uint32_t m_buffer;      // Bottleneck buffer (segments).
+  bool m_expectLowerPeak; // The buffer is deep enough for HyStart++ to not fill it.
+  Time m_duration;        // Simulated time.
+  uint32_t m_segmentSize;
+  Time m_serviceTime;     // Time to send one segment at the bottleneck.
+  Ptr<TcpSocketState> m_state;
+  Ptr<TcpCubic> m_cong;
+  std::vector<SegmentState> m_segments;
+  std::vector<uint32_t> m_sendOrder;                    // Order of the last send of each segment.
+  std::deque<std::pair<uint32_t, uint32_t> > m_sent;    // Order and segment, oldest first.
+  std::deque<uint32_t> m_retransmit;                    // Segments detected lost.
+  uint32_t m_order;       // Sends so far.
+  uint32_t m_pipe;        // Segments the sender believes in flight.
+  uint32_t m_cumAck;      // Segments received in order.
+  uint32_t m_recover;     // Recovery ends when all segments before this are ACKed.
+  Time m_lastDeparture;   // When the bottleneck buffer becomes empty.
+  EventId m_rto;
+  uint32_t m_peakQueue;
+  uint32_t m_lastCumAck;  // m_cumAck at the last sample.
+  Time m_steadyTime;      // End of the last RTT below 90% goodput.
+};
+
+TcpCubicHyStartBottleneckTest::TcpCubicHyStartBottleneckTest (
+    uint32_t bandwidth,
+    uint32_t rtt,
+    uint32_t buffer,
+    bool expectLowerPeak,
+    const std::string &name)
+  : TestCase (name),
+  m_bandwidth(bandwidth),
+  m_rtt(MilliSeconds (rtt)),
+  m_buffer(buffer),
+  m_expectLowerPeak(expectLowerPeak),
+  m_duration(Seconds (8)),
+  m_segmentSize(1448)
+{
+  m_serviceTime = NanoSeconds (m_segmentSize * 8 * 1000 / m_bandwidth);
+}
+
+void
+TcpCubicHyStartBottleneckTest::SendData ()
+{
+  while (m_pipe < m_state->GetCwndInSegments ())
+    {
+      uint32_t i = m_segments.size ();
+      if (!m_retransmit.empty ())
+        {
+          i = m_retransmit.front ();
+          m_retransmit.pop_front ();
+          if (m_segments[i] == ACKED)
+            {
+              continue; // ACKed after the timeout.
+            }
+        }
+      else
+        {
+          m_segments.push_back (IN_FLIGHT);
+          m_sendOrder.push_back (0);
+        }
+      Transmit (i);
+    }
+  m_state->m_highTxMark = SequenceNumber32 (m_segments.size () * m_segmentSize);
+  if (!m_rto.IsRunning ())
+    {
+      m_rto = Simulator::Schedule (Seconds (1), &TcpCubicHyStartBottleneckTest::Timeout, this);
+    }
+}
+
+void
+TcpCubicHyStartBottleneckTest::Transmit (uint32_t i)
+{
+  Time now = Simulator::Now ();
+  m_sendOrder[i] = m_order++;
+  m_sent.push_back (std::make_pair (m_sendOrder[i], i));
+  m_pipe++;
+
+  uint32_t queue = 0;
+  if (m_lastDeparture > now)
+    {
+      queue = (m_lastDeparture - now).GetNanoSeconds () / m_serviceTime.GetNanoSeconds ();
+    }
+  if (queue >= m_buffer)
+    {
+      m_segments[i] = DROPPED;
+      return;
+    }
+  m_segments[i] = IN_FLIGHT;
+  if (m_steadyTime == m_duration)
+    {
+      m_peakQueue = std::max (m_peakQueue, queue + 1);
+    }
+  m_lastDeparture = std::max (m_lastDeparture, now) + m_serviceTime;
+  Simulator::Schedule (m_lastDeparture + m_rtt - now,
+                       &TcpCubicHyStartBottleneckTest::ReceiveAck, this,
+                       i, m_sendOrder[i], now);
+}
+
+void
+TcpCubicHyStartBottleneckTest::ReceiveAck (uint32_t i, uint32_t order, Time sendTime)
+{
+  if (m_segments[i] == ACKED)
+    {
+      return;
+    }
+  if (m_segments[i] == IN_FLIGHT)
+    {
+      m_pipe--;
+    }
+  m_segments[i] = ACKED;
+  while (m_cumAck < m_segments.size () && m_segments[m_cumAck] == ACKED)
+    {
+      m_cumAck++;
+    }
+
+  // Anything sent three segments before this one and not ACKed is lost.
+  bool lossDetected = false;
+  while (!m_sent.empty ())
+    {
+      uint32_t j = m_sent.front ().second;
+      if (m_sendOrder[j] != m_sent.front ().first || m_segments[j] == ACKED)
+        {
+          m_sent.pop_front ();
+        }
+      else if (m_sent.front ().first + 3 <= order)
+        {
+          if (m_segments[j] == DROPPED)
+            {
+              m_pipe--;
+            }
+          m_segments[j] = LOST;
+          m_retransmit.push_back (j);
+          m_sent.pop_front ();
+          lossDetected = true;
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  m_rto.Cancel ();
+  m_state->m_lastAckedSeq = SequenceNumber32 (m_cumAck * m_segmentSize);
+  m_state->m_rcvTimestampEchoReply = sendTime.GetMilliSeconds ();
+  if (lossDetected && m_state->m_congState == TcpSocketState::CA_OPEN)
+    {
+      m_state->m_congState = TcpSocketState::CA_RECOVERY;
+      m_state->m_ssThresh = m_cong->GetSsThresh (m_state, m_pipe * m_segmentSize);
+      m_state->m_cWnd = m_state->m_ssThresh;
+      m_recover = m_segments.size ();
+    }
+  else if (m_state->m_congState == TcpSocketState::CA_OPEN
+           || m_state->m_congState == TcpSocketState::CA_LOSS)
+    {
+      m_state->m_rttSample = Simulator::Now () - sendTime;
+      m_cong->PktsAcked (m_state, 1, m_state->m_rttSample);
+      m_cong->IncreaseWindow (m_state, 1);
+    }
+  if (m_state->m_congState != TcpSocketState::CA_OPEN && m_cumAck >= m_recover)
+    {
+      m_state->m_congState = TcpSocketState::CA_OPEN;
+    }
+  SendData ();
+}
+
+void
+TcpCubicHyStartBottleneckTest::Timeout ()
+{
+  // Retransmit everything from the first unacknowledged segment on.
+  m_retransmit.clear ();
+  m_sent.clear ();
+  for (uint32_t i = m_cumAck; i < m_segments.size (); i++)
+    {
+      if (m_segments[i] != ACKED)
+        {
+          m_segments[i] = LOST;
+          m_retransmit.push_back (i);
+        }
+    }
+  m_state->m_congState = TcpSocketState::CA_LOSS;
+  m_state->m_ssThresh = m_cong->GetSsThresh (m_state, m_pipe * m_segmentSize);
+  m_state->m_cWnd = m_segmentSize;
+  m_recover = m_segments.size ();
+  m_pipe = 0;
+  SendData ();
+}
+
+void
+TcpCubicHyStartBottleneckTest::Sample ()
+{
+  double goodput = (m_cumAck - m_lastCumAck) * m_segmentSize * 8 / m_rtt.GetSeconds ();
+  if (m_steadyTime == m_duration && goodput >= 0.9e6 * m_bandwidth
+      && m_state->m_congState == TcpSocketState::CA_OPEN
+      && m_state->m_cWnd >= m_state->m_ssThresh)
+    {
+      m_steadyTime = Simulator::Now ();
+    }
+  m_lastCumAck = m_cumAck;
+  Simulator::Schedule (m_rtt, &TcpCubicHyStartBottleneckTest::Sample, this);
+}
+
+void
+TcpCubicHyStartBottleneckTest::RunFlow (bool hyStart, uint32_t &peakQueue, Time &steadyTime)
+{
+  m_state = CreateObject<TcpSocketState> ();
+  m_state->m_segmentSize = m_segmentSize;
+  m_state->m_cWnd = 10 * m_segmentSize;
+  m_state->m_ssThresh = UINT32_MAX;
+  m_state->m_congState = TcpSocketState::CA_OPEN;
+
+  m_cong = CreateObject <TcpCubic> ();
+  m_cong->SetAttribute ("HyStart", BooleanValue (hyStart));
+
+  m_segments.clear ();
+  m_sendOrder.clear ();
+  m_sent.clear ();
+  m_retransmit.clear ();
+  m_order = 0;
+  m_pipe = 0;
+  m_cumAck = 0;
+  m_recover = 0;
+  m_lastDeparture = Time ();
+  m_rto = EventId ();
+  m_peakQueue = 0;
+  m_lastCumAck = 0;
+  m_steadyTime = m_duration;
+
+  Simulator::Stop (m_duration);
+  Simulator::ScheduleNow (&TcpCubicHyStartBottleneckTest::SendData, this);
+  Simulator::Schedule (m_rtt, &TcpCubicHyStartBottleneckTest::Sample, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  peakQueue = m_peakQueue;
+  steadyTime = m_steadyTime;
+  NS_LOG_INFO ("HyStart " << hyStart << ": peak queue " << peakQueue
+               << " segments, steady throughput after " << steadyTime.GetSeconds () << " s");
+}
+
+//
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+//
+void
+TcpCubicHyStartBottleneckTest::DoRun (void)
+{
+
+  // Log the test.
+  LogComponentEnable("TcpCubic", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCongestionOps", LOG_LEVEL_INFO);
+  LogComponentEnable("TcpCubicTestSuite", LOG_LEVEL_INFO);
+
+  uint32_t peakQueue, peakQueueHyStart;
+  Time steadyTime, steadyTimeHyStart;
+  RunFlow (false, peakQueue, steadyTime);
+  RunFlow (true, peakQueueHyStart, steadyTimeHyStart);
+
+  if (m_expectLowerPeak)
+    {
+      NS_TEST_ASSERT_MSG_LT(peakQueueHyStart, peakQueue,
+        "HyStart++ did not lower the peak queue.");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_LT_OR_EQ(peakQueueHyStart, peakQueue,
+        "HyStart++ raised the peak queue.");
+    }
+  NS_TEST_ASSERT_MSG_LT(steadyTimeHyStart, steadyTime,
+    "HyStart++ did not reach steady throughput earlier.");
+  NS_TEST_ASSERT_MSG_LT(steadyTimeHyStart, m_duration,
+    "No steady throughput with HyStart++.");
+}
+
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -448,7 +1320,7 @@ public:
      *   cwnd1 (bytes) when CubicUpdate is called the first time (sets K)
      *   segment size (bytes)
      *   time (ms) when CubicUpdate is called
-     *   time (ms) set on the ack packet to echo, used to figure delay
+     *   RTT (us) of the ACKs, used to figure delay
      *   Expected number of ACKs CubicUpdate says are needed to update CWND for the 1st test
      *   cwnd (bytes) when CubicUpdate is called the 2nd time.
      *   time (ms) when CubicUpdate is called the 2nd time
@@ -462,22 +1334,48 @@ public:
      *
      * The values for the congestion windows, timestamps and expected ACK
      * counts come from a test run of the TCP Cubic implementation in
-     * ns-2.35.
+     * ns-2.35. ns-2 divides the ACK counts by its estimate of segments per
+     * ACK, which starts at 2; TcpCubic counts segments ACKed instead, so the
+     * expected counts are those of ns-2 before that division. In test case 1
+     * ns-2 approximates K = cbrt(557801020816) = 8231.8 as 8232, TcpCubic
+     * gets 8231: at the 2nd call the window target is then 9 rather than 8
+     * segments above cwnd (882 / 9 = 98 instead of 882 / 8 = 110). ns-2
+     * takes the RTT from the echoed timestamp, 127 ms in both tests.
      */
     AddTestCase (
-       new TcpCubicIncrementTest (556904, 445416, 536, 2436, 2309, 41,
-         472752, 3155, 55,
-         556904, 10358, 51950,
-         562264, 13465, 262,
+       new TcpCubicIncrementTest (556904, 445416, 536, 2436, 127000, 83,
+         472752, 3155, 98,
+         556904, 10358, 103900,
+         562264, 13465, 524,
          "CubicUpdate test case 1" ), TestCase::QUICK);
 
     AddTestCase (
-       new TcpCubicIncrementTest (621760, 553152, 536, 25276, 25149, 64,
-         618544, 29560, 577,
-         621760, 32002, 58000,
-         687152, 38874, 80,
+       new TcpCubicIncrementTest (621760, 553152, 536, 25276, 127000, 129,
+         618544, 29560, 1154,
+         621760, 32002, 116000,
+         687152, 38874, 160,
          "CubicUpdate test case 2" ), TestCase::QUICK);
 
+    /* The same with RTTs below a millisecond, as in a data center. The
+     * CUBIC clock counts microseconds, so the 4th call (t > K) gets the
+     * minimum ACK count of cwnd / (Smax * RTT / 0.1 s): 200 / 0.08 = 2500
+     * at 500 us, 200 / 0.0128 = 15625 at 80 us. A clock in milliseconds
+     * sees both RTTs as the same tick.
+     */
+    AddTestCase (
+       new TcpCubicIncrementTest (289600, 231680, 1448, 1000, 500, 160,
+         260640, 3000, 13,
+         289600, 5650, 20000,
+         289600, 9000, 2500,
+         "CubicUpdate with a 500 us RTT" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicIncrementTest (289600, 231680, 1448, 1000, 80, 160,
+         260640, 3000, 13,
+         289600, 5650, 20000,
+         289600, 9000, 15625,
+         "CubicUpdate with an 80 us RTT" ), TestCase::QUICK);
+
 
     /* Test GetSsthresh method.
      * Test the CUBIC method of setting the slow start threshold.
@@ -518,6 +1416,101 @@ public:
     AddTestCase (
        new TcpCubicPktsAckedTest (1, 31, "PktsAcked test 1" ), TestCase::QUICK);
 
+
+    /* Test CubicRoot, which finds K. */
+    AddTestCase (
+       new TcpCubicRootTest ("CubicRoot over the 64-bit range" ), TestCase::QUICK);
+
+    /* Test that delayed ACKs grow cwnd as fast as ACKs of every segment.
+     * Parameters:
+     *   Segments acknowledged per delayed ACK.
+     *   Whether to test slow start, or congestion avoidance after a loss.
+     *   Number of RTTs of 100 ms to run.
+     */
+    AddTestCase (
+       new TcpCubicDelayedAckTest (2, true, 6,
+         "Slow start with delayed ACKs" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicDelayedAckTest (2, false, 100,
+         "Congestion avoidance with delayed ACKs" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicDelayedAckTest (4, false, 100,
+         "Congestion avoidance with stretch ACKs" ), TestCase::QUICK);
+
+    /* Test that cwnd does not grow while the sender is application limited.
+     * Parameters:
+     *   Whether to test slow start, or congestion avoidance.
+     */
+    AddTestCase (
+       new TcpCubicAppLimitedTest (true,
+         "Application limited in slow start" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicAppLimitedTest (false,
+         "Application limited in congestion avoidance" ), TestCase::QUICK);
+
+    /* Test HyStart++.
+     * Parameters:
+     *   RTT increase (ms) from round 4 on, over a base RTT of 100 ms. The
+     *   threshold is 100 ms / 8 = 12.5 ms.
+     *   Whether the RTT goes back to 100 ms from round 6 on.
+     *   Whether CSS is expected to be entered in round 4.
+     *   Whether slow start is expected to be left.
+     */
+    AddTestCase (
+       new TcpCubicHyStartTest (20, false, true, true,
+         "HyStart++ leaves slow start after CSS" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicHyStartTest (10, false, false, false,
+         "HyStart++ ignores RTT increase below threshold" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicHyStartTest (20, true, true, false,
+         "HyStart++ resumes slow start when RTT falls" ), TestCase::QUICK);
+
+    /* Test HyStart++ on RTT samples taken by TcpSocketBase.
+     * Parameters:
+     *   RTT increase (ms) for the ACKs of round 2 on, over a base RTT of
+     *   100 ms.
+     *   Whether CSS is expected to be entered in round 2.
+     */
+    AddTestCase (
+       new TcpCubicHyStartRttTest (20, true,
+         "HyStart++ on socket RTT samples" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicHyStartRttTest (10, false,
+         "HyStart++ on socket RTT samples below threshold" ), TestCase::QUICK);
+
+    /* Compare slow start with and without HyStart++ through a bottleneck.
+     * Parameters:
+     *   Bottleneck bandwidth (Mbps).
+     *   Base RTT (ms).
+     *   Bottleneck buffer (segments).
+     *   Whether the buffer is deep enough for HyStart++ to leave slow start
+     *   before it is full. Otherwise both fill it, but HyStart++ loses less.
+     *
+     * The bandwidth-delay product is 86 segments in both configurations.
+     */
+    AddTestCase (
+       new TcpCubicHyStartBottleneckTest (10, 100, 1000, true,
+         "HyStart++ with a deep buffer at 10Mbps 100ms" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicHyStartBottleneckTest (50, 20, 1000, true,
+         "HyStart++ with a deep buffer at 50Mbps 20ms" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicHyStartBottleneckTest (10, 100, 344, false,
+         "HyStart++ with a 4 BDP buffer at 10Mbps 100ms" ), TestCase::QUICK);
+
+    AddTestCase (
+       new TcpCubicHyStartBottleneckTest (50, 20, 172, false,
+         "HyStart++ with a 2 BDP buffer at 50Mbps 20ms" ), TestCase::QUICK);
+
   }
 } g_tcpCubicTestSuite;
 
@@ -0,0 +1,345 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**
+ * Test cases for TCP delivery rate estimation (TcpRateLinux).
+ *
+ * Run this test class with
+ * ./test.py -v -s tcp-rate-ops-test-suite > log.out 2>&1
+ */
+
+#include "ns3/tcp-rate-ops.h"
+#include "ns3/test.h"
+#include "ns3/core-module.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpRateOpsTestSuite");
+
+static const uint32_t SEGMENT_SIZE = 1000;
+static const Time MIN_RTT = MilliSeconds (10);
+
+/*
+ * Base for tests driving a TcpRateLinux with segments sent and ACKs
+ * received at scheduled times.
+ */
+class TcpRateLinuxTestCase : public TestCase
+{
+public:
+  TcpRateLinuxTestCase (const std::string &name)
+    : TestCase (name)
+  {
+  }
+
+protected:
+  // Send segment number i (SEGMENT_SIZE bytes).
+  void SendSegment (uint32_t i, bool isStartOfTransmission)
+  {
+    m_rate->SkbSent (SequenceNumber32 (i * SEGMENT_SIZE), SEGMENT_SIZE,
+                     isStartOfTransmission);
+  }
+
+  // Receive ACK for all segments before segment number ack, plus SACK of
+  // segments [sackStart, sackEnd) if not empty, and generate its sample.
+  const TcpRateOps::TcpRateSample & ReceiveAck (uint32_t ack,
+                                                uint32_t sackStart = 0,
+                                                uint32_t sackEnd = 0)
+  {
+    if (sackEnd > sackStart)
+      {
+        TcpOptionSack::SackList list;
+        list.push_back (std::make_pair (SequenceNumber32 (sackStart * SEGMENT_SIZE),
+                                        SequenceNumber32 (sackEnd * SEGMENT_SIZE)));
+        m_rate->SkbSacked (list);
+      }
+    m_rate->SkbAcked (SequenceNumber32 (ack * SEGMENT_SIZE));
+    return m_rate->GenerateSample (MIN_RTT);
+  }
+
+  // Check the rate sample: delivered bytes and interval (ms).
+  void CheckSample (const TcpRateOps::TcpRateSample &rs,
+                    int64_t delivered, double intervalMs)
+  {
+    NS_TEST_EXPECT_MSG_EQ (rs.m_delivered, delivered,
+                           "Delivered differs at " << Simulator::Now ().GetSeconds ());
+    NS_TEST_EXPECT_MSG_EQ_TOL (rs.m_interval.GetSeconds () * 1000, intervalMs, 1e-6,
+                               "Interval differs at " << Simulator::Now ().GetSeconds ());
+    NS_TEST_EXPECT_MSG_EQ_TOL ((double) rs.m_deliveryRate.GetBitRate (),
+                               delivered * 8 * 1000 / intervalMs, 1,
+                               "Rate differs at " << Simulator::Now ().GetSeconds ());
+  }
+
+  Ptr<TcpRateLinux> m_rate;
+};
+
+/*
+ * One flight of 10 segments sent 1 ms apart, each ACKed one min RTT
+ * later and replaced by a new segment. Samples of the first flight span
+ * from the start of transmission; samples of the second flight measure
+ * exactly the ACK clocked rate of one segment per ms.
+ */
+class TcpRateLinuxFlightTest : public TcpRateLinuxTestCase
+{
+public:
+  TcpRateLinuxFlightTest ()
+    : TcpRateLinuxTestCase ("Rate samples over two flights")
+  {
+  }
+
+private:
+  virtual void DoRun (void)
+  {
+    m_rate = CreateObject<TcpRateLinux> ();
+    for (uint32_t i = 0; i < 10; i++)
+      {
+        Simulator::Schedule (MilliSeconds (i),
+                             &TcpRateLinuxFlightTest::SendSegment, this, i, i == 0);
+      }
+    for (uint32_t i = 0; i < 20; i++)
+      {
+        Simulator::Schedule (MilliSeconds (10 + i),
+                             &TcpRateLinuxFlightTest::Ack, this, i);
+      }
+    Simulator::Run ();
+    Simulator::Destroy ();
+
+    NS_TEST_ASSERT_MSG_EQ (m_rate->GetConnectionRate ().m_delivered,
+                           20 * SEGMENT_SIZE, "Delivered bytes differ");
+  }
+
+  void Ack (uint32_t i)
+  {
+    const TcpRateOps::TcpRateSample &rs = ReceiveAck (i + 1);
+    if (i < 10)
+      {
+        // First flight: from send of segment 0 to ACK of segment i.
+        CheckSample (rs, (i + 1) * SEGMENT_SIZE, 10 + i);
+      }
+    else
+      {
+        // Second flight: 10 segments delivered per 10 ms.
+        CheckSample (rs, 10 * SEGMENT_SIZE, 10);
+      }
+    NS_TEST_EXPECT_MSG_EQ (rs.m_ackedSacked, SEGMENT_SIZE, "ACKed bytes differ");
+    NS_TEST_EXPECT_MSG_EQ (rs.m_isAppLimited, false, "Sample app-limited");
+
+    if (i + 10 < 20)
+      {
+        SendSegment (i + 10, false);
+      }
+  }
+};
+
+/*
+ * Segment 1 is lost, segments 2-9 are SACKed, then the retransmission of
+ * segment 1 is cumulatively ACKed. SACKed segments give samples when
+ * SACKed and are not delivered again by the cumulative ACK.
+ */
+class TcpRateLinuxSackTest : public TcpRateLinuxTestCase
+{
+public:
+  TcpRateLinuxSackTest ()
+    : TcpRateLinuxTestCase ("Rate samples with SACK and retransmission")
+  {
+  }
+
+private:
+  virtual void DoRun (void)
+  {
+    m_rate = CreateObject<TcpRateLinux> ();
+    for (uint32_t i = 0; i < 10; i++)
+      {
+        Simulator::Schedule (MilliSeconds (i),
+                             &TcpRateLinuxSackTest::SendSegment, this, i, i == 0);
+      }
+    Simulator::Schedule (MilliSeconds (10), &TcpRateLinuxSackTest::Ack, this);
+    for (uint32_t i = 2; i < 10; i++)
+      {
+        Simulator::Schedule (MilliSeconds (10 + i),
+                             &TcpRateLinuxSackTest::Sack, this, i);
+      }
+    Simulator::Schedule (MilliSeconds (22), &TcpRateLinuxSackTest::RetransAck, this);
+    Simulator::Run ();
+    Simulator::Destroy ();
+  }
+
+  void Ack (void)
+  {
+    CheckSample (ReceiveAck (1), SEGMENT_SIZE, 10);
+  }
+
+  void Sack (uint32_t i)
+  {
+    // Segment 0 and segments 2 to i delivered, all sent in the first flight.
+    const TcpRateOps::TcpRateSample &rs = ReceiveAck (1, 2, i + 1);
+    CheckSample (rs, i * SEGMENT_SIZE, 10 + i);
+    NS_TEST_EXPECT_MSG_EQ (rs.m_ackedSacked, SEGMENT_SIZE, "SACKed bytes differ");
+
+    if (i == 2)
+      {
+        // Retransmit lost segment.
+        SendSegment (1, false);
+      }
+  }
+
+  void RetransAck (void)
+  {
+    // Only the retransmission is newly delivered, over the 10 ms since
+    // it was sent (2 segments had been delivered then).
+    const TcpRateOps::TcpRateSample &rs = ReceiveAck (10);
+    CheckSample (rs, 8 * SEGMENT_SIZE, 10);
+    NS_TEST_EXPECT_MSG_EQ (rs.m_ackedSacked, SEGMENT_SIZE, "ACKed bytes differ");
+    NS_TEST_EXPECT_MSG_EQ (rs.m_isRetrans, true, "Sample not retransmission");
+    NS_TEST_EXPECT_MSG_EQ (m_rate->GetConnectionRate ().m_delivered,
+                           10 * SEGMENT_SIZE, "SACKed bytes counted twice");
+  }
+};
+
+/*
+ * The application runs out of data after 2 segments and later writes a
+ * third. Samples from segments sent until what was in flight is
+ * delivered are app-limited, later ones are not.
+ */
+class TcpRateLinuxAppLimitedTest : public TcpRateLinuxTestCase
+{
+public:
+  TcpRateLinuxAppLimitedTest ()
+    : TcpRateLinuxTestCase ("App-limited rate samples")
+  {
+  }
+
+private:
+  virtual void DoRun (void)
+  {
+    m_rate = CreateObject<TcpRateLinux> ();
+    Simulator::Schedule (MilliSeconds (0),
+                         &TcpRateLinuxAppLimitedTest::SendSegment, this, 0, true);
+    Simulator::Schedule (MilliSeconds (1),
+                         &TcpRateLinuxAppLimitedTest::SendLast, this);
+    Simulator::Schedule (MilliSeconds (5),
+                         &TcpRateLinuxAppLimitedTest::SendSegment, this, 2, false);
+    Simulator::Schedule (MilliSeconds (10),
+                         &TcpRateLinuxAppLimitedTest::Ack, this, 0, false);
+    Simulator::Schedule (MilliSeconds (11),
+                         &TcpRateLinuxAppLimitedTest::Ack, this, 1, false);
+    Simulator::Schedule (MilliSeconds (15),
+                         &TcpRateLinuxAppLimitedTest::Ack, this, 2, true);
+    Simulator::Schedule (MilliSeconds (25),
+                         &TcpRateLinuxAppLimitedTest::Ack, this, 3, false);
+    Simulator::Run ();
+    Simulator::Destroy ();
+  }
+
+  void SendLast (void)
+  {
+    SendSegment (1, false);
+    // Nothing more to send, 2 segments in flight, room in cwnd.
+    m_rate->CalculateAppLimited (10 * SEGMENT_SIZE, 2 * SEGMENT_SIZE,
+                                 SEGMENT_SIZE, 0);
+    NS_TEST_EXPECT_MSG_EQ (m_rate->GetConnectionRate ().m_appLimited,
+                           2 * SEGMENT_SIZE, "App-limited mark differs");
+  }
+
+  void Ack (uint32_t i, bool appLimited)
+  {
+    const TcpRateOps::TcpRateSample &rs = ReceiveAck (i + 1);
+    NS_TEST_EXPECT_MSG_EQ (rs.m_isAppLimited, appLimited,
+                           "App-limited differs for segment " << i);
+    if (i == 2)
+      {
+        // In-flight data at the mark delivered, so no longer app-limited.
+        NS_TEST_EXPECT_MSG_EQ (m_rate->GetConnectionRate ().m_appLimited,
+                               0, "App-limited mark not cleared");
+        SendSegment (3, false);
+      }
+  }
+};
+
+/*
+ * Ten segments kept in flight for 1000 ACKs, as in the second flight of
+ * TcpRateLinuxFlightTest. The delivery state of the first flight sets the
+ * size of the segment store; from the first ACK on, neither ACKs nor
+ * transmissions may grow it.
+ */
+class TcpRateLinuxSteadyStateTest : public TcpRateLinuxTestCase
+{
+public:
+  TcpRateLinuxSteadyStateTest ()
+    : TcpRateLinuxTestCase ("No allocation in steady state"),
+      m_bytes (0),
+      m_grown (0)
+  {
+  }
+
+private:
+  virtual void DoRun (void)
+  {
+    m_rate = CreateObject<TcpRateLinux> ();
+    m_rate->TraceConnectWithoutContext ("SegmentsBytes",
+      MakeCallback (&TcpRateLinuxSteadyStateTest::BytesTrace, this));
+    for (uint32_t i = 0; i < 10; i++)
+      {
+        Simulator::Schedule (MilliSeconds (i),
+                             &TcpRateLinuxSteadyStateTest::SendSegment, this, i, i == 0);
+      }
+    for (uint32_t i = 0; i < 1000; i++)
+      {
+        Simulator::Schedule (MilliSeconds (10 + i),
+                             &TcpRateLinuxSteadyStateTest::Ack, this, i);
+      }
+    Simulator::Run ();
+    Simulator::Destroy ();
+
+    NS_TEST_ASSERT_MSG_GT (m_bytes, 0, "Segment store not traced");
+    NS_TEST_ASSERT_MSG_EQ (m_grown, 0, "Segment store grew in steady state");
+  }
+
+  void BytesTrace (uint32_t oldValue, uint32_t newValue)
+  {
+    m_bytes = newValue;
+    if (Simulator::Now () >= MilliSeconds (10))
+      {
+        m_grown++;
+      }
+  }
+
+  void Ack (uint32_t i)
+  {
+    const TcpRateOps::TcpRateSample &rs = ReceiveAck (i + 1);
+    if (i >= 10)
+      {
+        CheckSample (rs, 10 * SEGMENT_SIZE, 10);
+      }
+    SendSegment (i + 10, false);
+  }
+
+  uint32_t m_bytes;  // Last SegmentsBytes traced.
+  uint32_t m_grown;  // Times SegmentsBytes changed after the first ACK.
+};
+
+static class TcpRateOpsTestSuite : public TestSuite
+{
+public:
+  TcpRateOpsTestSuite () : TestSuite ("tcp-rate-ops-test-suite", UNIT)
+  {
+    AddTestCase (new TcpRateLinuxFlightTest (), TestCase::QUICK);
+    AddTestCase (new TcpRateLinuxSackTest (), TestCase::QUICK);
+    AddTestCase (new TcpRateLinuxAppLimitedTest (), TestCase::QUICK);
+    AddTestCase (new TcpRateLinuxSteadyStateTest (), TestCase::QUICK);
+  }
+} g_tcpRateOpsTestSuite;
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+パラメータの組み合わせ（マトリクス）ごとのシミュレーションを，
+並列に実行するツール．scenario_*.sh から使う．
+
+使い方:
+    python3 sweep.py -j 8 --out data/runs --name 05_xx-sc1 \\
+        --axis transport_prot=TcpNewReno \\
+        --axis bandwidth=10Mbps,50Mbps --axis delay=10ms,100ms \\
+        chapter5-base --tracing=True --duration=100
+
+    --axis の全組み合わせについて，
+        chapter5-base --transport_prot=... --bandwidth=... --delay=...
+                      --tracing=True --duration=100
+                      --prefix_name=<out>/<run>/<run>
+    を実行する．<run> は --name と各 --axis の値を"-"でつないだ名前
+    （例: 05_xx-sc1-TcpNewReno-10Mbps-10ms）で，実行ごとに専用の
+    ディレクトリ <out>/<run>/ を作り，出力とログ（log.txt）をそこに置く．
+
+    ビルドは最初に一度だけ行い（./waf build），各実行は
+    ./waf --run-no-build で行う．
+
+    結果はキャッシュ（--cache，既定は data/cache）に保存し，同じ
+    キー（プログラムと ns-3 ライブラリの内容，--prefix_name 以外の
+    引数，環境変数 NS_GLOBAL_VALUE）の実行では再利用する．シード
+    （--RngSeed，--RngRun）も引数としてキーに含まれる．
+
+    --spec で同じ内容をJSONで与えてもよい:
+        {"program": "chapter5-base", "name": "05_xx-sc1",
+         "axes": [["bandwidth", ["10Mbps", "50Mbps"]], ...],
+         "args": ["--tracing=True", "--duration=100"]}
+"""
+
+import argparse
+import concurrent.futures
+import glob
+import hashlib
+import itertools
+import json
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+import time
+
+
+# "key=v1,v2" を (key, [v1, v2]) にする関数．
+def parse_axis(text):
+    key, sep, values = text.partition('=')
+    if not sep or not key or not values:
+        raise argparse.ArgumentTypeError(
+            'axis must be KEY=VALUE[,VALUE...]: {}'.format(text))
+    return key, values.split(',')
+
+
+# 全組み合わせについて (実行名, 引数のリスト) を返す関数．
+def make_runs(name, axes, args):
+    keys = [key for key, _ in axes]
+    runs = []
+    for values in itertools.product(*[values for _, values in axes]):
+        run = '-'.join([name] + list(values))
+        run_args = ['--{}={}'.format(k, v) for k, v in zip(keys, values)]
+        runs.append((run, run_args + list(args)))
+    return runs
+
+
+# ビルドされたプログラムと ns-3 ライブラリの内容のハッシュを返す関数．
+# プログラムが見つからなければ None を返す．
+def build_id(build, program):
+    name = re.compile(r'(ns3[^-]*-)?{}(-\w+)?$'.format(re.escape(program)))
+    binaries = [f for f in glob.glob(os.path.join(build, 'scratch', '**', '*'),
+                                     recursive=True)
+                if name.match(os.path.basename(f)) and os.path.isfile(f)
+                and os.access(f, os.X_OK)]
+    if not binaries:
+        return None
+    libraries = glob.glob(os.path.join(build, 'libns3*.so*')) + \
+        glob.glob(os.path.join(build, 'lib', 'libns3*.so*'))
+    h = hashlib.sha256()
+    for f in sorted(binaries) + sorted(libraries):
+        with open(f, 'rb') as data:
+            for block in iter(lambda: data.read(1 << 20), b''):
+                h.update(block)
+    return h.hexdigest()
+
+
+# 実行のキャッシュキーを返す関数．
+def cache_key(build, program, args):
+    key = [build, program, os.environ.get('NS_GLOBAL_VALUE', '')] + args
+    return hashlib.sha256('\0'.join(key).encode()).hexdigest()
+
+
+# src の run で始まるファイルを，名前の先頭を替えて dst にコピーする関数．
+def copy_run(src, run, dst, new_run):
+    for f in os.listdir(src):
+        if f.startswith(run):
+            shutil.copy2(os.path.join(src, f),
+                         os.path.join(dst, new_run + f[len(run):]))
+
+
+# 1つのシミュレーションを実行し，(実行名, 結果, 時間[s]) を返す関数．
+# 結果は終了コードか，キャッシュを使ったときは 'cached'．
+def simulate(waf, program, out, run, args, cache=None):
+    path = os.path.join(out, run)
+    # 以前の結果はこの実行のディレクトリだけ消す．
+    shutil.rmtree(path, ignore_errors=True)
+    os.makedirs(path)
+
+    # キャッシュの中では，ファイル名の先頭の実行名を "run" にしておく．
+    if cache and os.path.isdir(cache):
+        copy_run(cache, 'run', path, run)
+        with open(os.path.join(path, 'log.txt'), 'w') as log:
+            log.write('cached: {}\n'.format(cache))
+        return run, 'cached', 0.0
+
+    command = ' '.join(
+        [program] + [shlex.quote(a) for a in args] +
+        ['--prefix_name=' + shlex.quote(os.path.join(path, run))])
+    start = time.time()
+    with open(os.path.join(path, 'log.txt'), 'w') as log:
+        log.write(command + '\n')
+        log.flush()
+        code = subprocess.call([waf, '--run-no-build', command],
+                               stdout=log, stderr=subprocess.STDOUT)
+    seconds = time.time() - start
+
+    # 全て書いてから名前を変えるので，並列に実行しても壊れない．
+    if cache and code == 0:
+        temp = '{}.{}.tmp'.format(cache, os.getpid())
+        shutil.rmtree(temp, ignore_errors=True)
+        os.makedirs(temp)
+        copy_run(path, run, temp, 'run')
+        shutil.copy2(os.path.join(path, 'log.txt'), temp)
+        try:
+            os.rename(temp, cache)
+        except OSError:
+            shutil.rmtree(temp)  # 同じ結果がもう保存されている．
+    return run, code, seconds
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run a parameter matrix of simulations in parallel.')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(),
+                        help='max simulations at once (default: all cores)')
+    parser.add_argument('--out', default='data/runs',
+                        help='directory of the per-run directories')
+    parser.add_argument('--name', help='prefix of run names')
+    parser.add_argument('--axis', type=parse_axis, action='append',
+                        default=[], help='KEY=VALUE[,VALUE...] to vary')
+    parser.add_argument('--spec', help='JSON file with program/name/axes/args')
+    parser.add_argument('--no-build', action='store_true',
+                        help='do not run ./waf build first')
+    parser.add_argument('--cache', default='data/cache',
+                        help='directory of cached results')
+    parser.add_argument('--no-cache', action='store_true',
+                        help='always simulate, and do not store results')
+    parser.add_argument('--build', default='build',
+                        help='waf build directory')
+    parser.add_argument('--waf', default='./waf', help='waf to run')
+    parser.add_argument('program', nargs='?', help='ns-3 program to run')
+    parser.add_argument('args', nargs=argparse.REMAINDER,
+                        help='arguments given to every run')
+    args = parser.parse_args()
+
+    program, name, axes, fixed = args.program, args.name, args.axis, args.args
+    if args.spec:
+        with open(args.spec) as f:
+            spec = json.load(f)
+        program = program or spec['program']
+        name = name or spec['name']
+        axes = [(k, list(map(str, v))) for k, v in spec.get('axes', [])] + axes
+        fixed = list(map(str, spec.get('args', []))) + fixed
+    if not program or not name:
+        parser.error('program and --name (or --spec) are required')
+    if args.jobs < 1:
+        parser.error('--jobs must be at least 1')
+
+    runs = make_runs(name, axes, fixed)
+    if not args.no_build:
+        subprocess.check_call([args.waf, 'build'])
+
+    build = None
+    if not args.no_cache:
+        build = build_id(args.build, program)
+        if build is None:
+            print('{} not found in {}; not caching'.format(
+                program, args.build), file=sys.stderr)
+
+    failed = []
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        futures = []
+        for run, a in runs:
+            cache = None
+            if build:
+                cache = os.path.join(args.cache,
+                                     cache_key(build, program, a))
+            futures.append(pool.submit(simulate, args.waf, program,
+                                       args.out, run, a, cache))
+        for i, future in enumerate(
+                concurrent.futures.as_completed(futures), 1):
+            run, code, seconds = future.result()
+            status = {0: 'done', 'cached': 'cached'}.get(code, 'FAILED')
+            print('[{}/{}] {} {} ({:.0f} s)'.format(
+                i, len(runs), status, run, seconds), flush=True)
+            if status == 'FAILED':
+                failed.append(run)
+
+    for run in sorted(failed):
+        print('failed: {}'.format(os.path.join(args.out, run, 'log.txt')),
+              file=sys.stderr)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
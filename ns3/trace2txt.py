@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+バイナリ形式のトレースファイル（--binary_trace=True で出力）を，
+gnuplot等で読める"time value..."形式のテキストに変換するツール．
+キューのイベントログ（--queue_events=True で出力）は
+"time event packets bytes sojourn"形式に変換する．
+eventは0: enqueue，1: dequeue，2: dropで，sojournはdequeue以外では0．
+
+使い方:
+    python3 trace2txt.py <file>            # 標準出力へ
+    python3 trace2txt.py -o out.data <file>
+    python3 trace2txt.py --in-place <file>...  # ファイル名はそのまま
+
+形式は scratch/trace-sink.h，scratch/queue-tracer.h を参照．
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'NS3T'
+HEADER = struct.Struct('=4sBB2x')
+# バージョン1（1列のみ）のヘッダ．
+HEADER_V1 = struct.Struct('=4sBc2x')
+
+QUEUE_MAGIC = b'NS3Q'
+QUEUE_HEADER = struct.Struct('=4sB3x')
+QUEUE_RECORD = struct.Struct('=qqII')
+ENQUEUE = -1
+DROP = -2
+
+
+# キューのイベントログを読み，テキストの行のリストを返す関数．
+def convert_queue(data):
+    magic, version = QUEUE_HEADER.unpack_from(data)
+    if version != 1:
+        raise ValueError('unknown queue log version')
+
+    lines = []
+    offset = QUEUE_HEADER.size
+    end = len(data) - (len(data) - offset) % QUEUE_RECORD.size
+    for ns, sojourn, packets, nbytes in QUEUE_RECORD.iter_unpack(
+            data[offset:end]):
+        if sojourn == ENQUEUE:
+            event, sojourn = 0, 0
+        elif sojourn == DROP:
+            event, sojourn = 2, 0
+        else:
+            event = 1
+        lines.append('{:g} {:d} {:d} {:d} {:g}\n'.format(
+            ns / 1e9, event, packets, nbytes, sojourn / 1e9))
+    return lines
+
+
+# バイナリトレースを読み，テキストの行のリストを返す関数．
+def convert(data):
+    if len(data) < HEADER.size:
+        raise ValueError('too short for a trace header')
+    if data[:4] == QUEUE_MAGIC:
+        return convert_queue(data)
+    magic, version, ncols = HEADER.unpack_from(data)
+    if magic != MAGIC or version not in (1, 2):
+        raise ValueError('not a binary trace (already text?)')
+
+    if version == 1:
+        kinds = HEADER_V1.unpack_from(data)[2]
+        offset = HEADER_V1.size
+    else:
+        kinds = data[HEADER.size:HEADER.size + ncols]
+        offset = HEADER.size + (ncols + 7) // 8 * 8
+        if len(kinds) != ncols:
+            raise ValueError('too short for a trace header')
+    if not kinds or kinds.strip(b'ud'):
+        raise ValueError('bad column kinds')
+
+    # 値の表記はC++側（%g, %u）と同じ．
+    fmt = '{:g}' + ''.join(' {:d}' if k == ord('u') else ' {:g}'
+                           for k in kinds) + '\n'
+    casts = [int if k == ord('u') else float for k in kinds]
+    record = struct.Struct('=q' + 'd' * len(kinds))
+
+    lines = []
+    end = len(data) - (len(data) - offset) % record.size
+    for ns, *values in record.iter_unpack(data[offset:end]):
+        values = [c(v) for c, v in zip(casts, values)]
+        lines.append(fmt.format(ns / 1e9, *values))
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert binary trace files to "time value..." text.')
+    parser.add_argument('files', nargs='+', help='binary trace files')
+    parser.add_argument('-o', '--output', help='output file (one input)')
+    parser.add_argument('--in-place', action='store_true',
+                        help='replace each file with its text version')
+    args = parser.parse_args()
+
+    if args.output and (args.in_place or len(args.files) > 1):
+        parser.error('--output takes exactly one input file')
+    if not args.in_place and not args.output and len(args.files) > 1:
+        parser.error('use --in-place to convert several files')
+
+    status = 0
+    for name in args.files:
+        with open(name, 'rb') as f:
+            data = f.read()
+        try:
+            lines = convert(data)
+        except ValueError as e:
+            print('{}: {}'.format(name, e), file=sys.stderr)
+            status = 1
+            continue
+
+        if args.in_place or args.output:
+            with open(name if args.in_place else args.output, 'w') as f:
+                f.writelines(lines)
+        else:
+            sys.stdout.writelines(lines)
+    return status
+
+
+if __name__ == '__main__':
+    sys.exit(main())